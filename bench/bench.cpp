@@ -0,0 +1,639 @@
+// Headless benchmark for the simulation hot paths.
+//
+// Usage: sandsim_bench [--size WxH]... [--scene pile|settled|mixed|sparse|basin|heap] [--ticks N] [--warmup N] [--queries N]
+//                      [--no-sleep] [--threads N] [--engine scan|bitboard|margolus] [--worklist auto|dense|sparse]
+//                      [--water cellular|hydrostatic] [--layout rowmajor|tiled|chunked|zorder] [--seed N]
+//                      [--paged FILE] [--snapshot FILE] [--backend cellular|particles] [--multires]
+//                      [--heightfield] [--checkpoints] [--expect-hash HEX] [--check-restore]
+//        sandsim_bench --replay FILE [--replay-runs N]
+//
+// --expect-hash turns a run into a regression check: with a single --size, the grid hash
+// after the Update pass must equal HEX, and the other benchmarks are skipped.
+// --check-restore is the same for saving: with a single --size and --snapshot FILE, the
+// run is saved halfway to a snapshot and a checkpoint, and both must finish it on the
+// live run's grid.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+
+#include "core/cell.h"
+#include "core/cell_storage.h"
+#include "core/checkpoint_timeline.h"
+#include "core/random.h"
+#include "core/haptic_system.h"
+#include "core/input_journal.h"
+#include "core/particle_simulation.h"
+#include "core/sand_simulation.h"
+#include "core/snapshot_file.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint64_t SCENE_STREAM = 100;
+
+enum class Scene { Pile, Settled, Mixed, Sparse, Basin, Heap };
+
+struct BenchConfig {
+    std::vector<glm::ivec2> sizes;
+    Scene scene = Scene::Pile;
+    int ticks = 200;
+    int warmup = 20;
+    int queries = 20000;
+    bool chunkSleeping = true;
+    int threads = 1;
+    UpdateEngine engine = UpdateEngine::Scan;
+    WorklistMode worklistMode = WorklistMode::Auto;
+    WaterMode waterMode = WaterMode::Cellular;
+    GridLayout layout = GridLayout::RowMajor;
+    BackendType backend = BackendType::Cellular;
+    bool multiResolution = false;
+    bool heightfield = false;
+    bool checkpoints = false;
+    uint64_t seed = DEFAULT_SEED;
+    std::string pagedPath;
+    std::string snapshotPath;
+    std::string replayPath;
+    int replayRuns = 1;
+    bool checkHash = false;
+    uint64_t expectHash = 0;
+    bool checkRestore = false;
+};
+
+double ElapsedNs(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// Resident set size of the whole process, from /proc/self/statm
+double ResidentMiB() {
+    long total = 0;
+    long pages = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) return 0.0;
+    if (std::fscanf(statm, "%ld %ld", &total, &pages) != 2) pages = 0;
+    std::fclose(statm);
+    return static_cast<double>(pages) * sysconf(_SC_PAGESIZE) / 1048576.0;
+}
+
+const char* EngineName(UpdateEngine engine) {
+    switch (engine) {
+        case UpdateEngine::Scan:     return "scan";
+        case UpdateEngine::Bitboard: return "bitboard";
+        case UpdateEngine::Margolus: return "margolus";
+        default:                     return "?";
+    }
+}
+
+const char* WorklistName(WorklistMode mode) {
+    switch (mode) {
+        case WorklistMode::Auto:   return "auto";
+        case WorklistMode::Dense:  return "dense";
+        case WorklistMode::Sparse: return "sparse";
+        default:                   return "?";
+    }
+}
+
+const char* WaterName(WaterMode mode) {
+    switch (mode) {
+        case WaterMode::Cellular:    return "cellular";
+        case WaterMode::Hydrostatic: return "hydrostatic";
+        default:                     return "?";
+    }
+}
+
+const char* LayoutName(GridLayout layout) {
+    switch (layout) {
+        case GridLayout::RowMajor: return "rowmajor";
+        case GridLayout::Tiled:    return "tiled";
+        case GridLayout::Chunked:  return "chunked";
+        case GridLayout::ZOrder:   return "zorder";
+        default:                   return "?";
+    }
+}
+
+const char* SceneName(Scene scene) {
+    switch (scene) {
+        case Scene::Pile:    return "pile";
+        case Scene::Settled: return "settled";
+        case Scene::Mixed:   return "mixed";
+        case Scene::Sparse:  return "sparse";
+        case Scene::Basin:   return "basin";
+        case Scene::Heap:    return "heap";
+    }
+    return "?";
+}
+
+// Fills the grid with a reproducible synthetic scene, generated into a buffer and blitted in
+void BuildScene(SandSimulation& sim, Scene scene) {
+    sim.Clear();
+    std::vector<PackedCell> cells(static_cast<size_t>(sim.width) * sim.height, 0);
+    for (int y = 0; y < sim.height; ++y) {
+        for (int x = 0; x < sim.width; ++x) {
+            float fy = static_cast<float>(y) / static_cast<float>(sim.height);
+            uint64_t r = CounterRandom(sim.seed, 0, x, y, SCENE_STREAM);
+            auto set = [&](MaterialType type) { cells[static_cast<size_t>(y) * sim.width + x] = PackCell(type, 0); };
+            switch (scene) {
+                case Scene::Pile:
+                    // A loose cloud of grains in the upper half that keeps falling for many ticks
+                    if (fy < 0.5f && r % 2 == 0) set(MaterialType::Sand);
+                    break;
+                case Scene::Settled:
+                    if (fy >= 0.4f) set(MaterialType::Sand);
+                    break;
+                case Scene::Mixed:
+                    if (fy >= 0.6f) set(MaterialType::Sand);
+                    else if (fy >= 0.3f && r % 3 == 0) set(MaterialType::Water);
+                    else if (fy < 0.3f && r % 4 == 0) set(MaterialType::Sand);
+                    break;
+                case Scene::Sparse:
+                    // A few scattered grains and drops over a mostly empty world
+                    if (fy < 0.5f && r % 256 == 0) set(MaterialType::Sand);
+                    else if (fy < 0.5f && r % 256 == 1) set(MaterialType::Water);
+                    break;
+                case Scene::Basin:
+                    // A tall block of water against the left wall that has to spread across the floor
+                    if (fy >= 0.2f && x < sim.width / 4) set(MaterialType::Water);
+                    break;
+                case Scene::Heap:
+                    // A narrow column of sand in the middle that slumps into a heap
+                    if (fy < 0.5f && std::abs(x - sim.width / 2) < sim.width / 32 + 1) set(MaterialType::Sand);
+                    break;
+            }
+        }
+    }
+    sim.BlitRegion(0, 0, sim.width, sim.height, cells.data());
+}
+
+void BenchUpdate(SandSimulation& sim, const BenchConfig& cfg) {
+    for (int i = 0; i < cfg.warmup; ++i) sim.Update();
+
+    auto start = Clock::now();
+    for (int i = 0; i < cfg.ticks; ++i) sim.Update();
+    double ns = ElapsedNs(start);
+
+    double cells = static_cast<double>(sim.width) * sim.height * cfg.ticks;
+    std::printf("  %-22s %12.1f ticks/s %10.3f ns/cell  awake chunks %d/%d  %s  hash %016llx\n", "Update",
+                cfg.ticks * 1e9 / ns, ns / cells, sim.GetAwakeChunkCount(), sim.GetChunksX() * sim.GetChunksY(),
+                sim.IsSparseActive() ? "sparse" : "dense", static_cast<unsigned long long>(sim.ComputeGridHash()));
+    if (sim.multiResolution) {
+        std::printf("  %-22s %12d of %d chunks\n", "Coarse", sim.GetCoarseChunkCount(), sim.GetChunksX() * sim.GetChunksY());
+    }
+    if (sim.heightfield) std::printf("  %-22s %12d of %d columns\n", "Beds", sim.GetBedColumnCount(), sim.width);
+}
+
+// Ticks from a fresh scene until every chunk sleeps, e.g. until a basin has levelled
+void BenchSettle(SandSimulation& sim, Scene scene) {
+    constexpr int MAX_TICKS = 10000;
+    BuildScene(sim, scene);
+
+    int ticks = 0;
+    int quietTicks = 0;
+    auto start = Clock::now();
+    while (ticks < MAX_TICKS && quietTicks <= sim.waterLevelIntervalTicks) {
+        sim.Update();
+        ++ticks;
+        quietTicks = sim.GetAwakeChunkCount() == 0 ? quietTicks + 1 : 0;
+    }
+    double ns = ElapsedNs(start);
+
+    if (ticks < MAX_TICKS) {
+        std::printf("  %-22s %12d ticks %13.3f ms\n", "Settle", ticks, ns * 1e-6);
+    } else {
+        std::printf("  %-22s %12s %d ticks %6.3f ms\n", "Settle", "not after", MAX_TICKS, ns * 1e-6);
+    }
+}
+
+// Surface profile of a settled heap, for comparing the angle of repose between engines
+void BenchShape(const SimulationBackend& world) {
+    const int width = world.GetWidth();
+    const int height = world.GetHeight();
+    std::vector<PackedCell> cells;
+    world.ExportCells(cells);
+
+    std::vector<int> heights(width, 0);
+    for (int x = 0; x < width; ++x) {
+        for (int y = 0; y < height; ++y) {
+            if (UnpackCell(cells[static_cast<size_t>(y) * width + x]).type != MaterialType::Empty) {
+                heights[x] = height - y;
+                break;
+            }
+        }
+    }
+
+    int peak = *std::max_element(heights.begin(), heights.end());
+    int base = static_cast<int>(std::count_if(heights.begin(), heights.end(), [](int h) { return h > 0; }));
+    double rise = 0.0;
+    int steps = 0;
+    for (int x = 0; x + 1 < width; ++x) {
+        if (heights[x] == 0 && heights[x + 1] == 0) continue;
+        rise += std::abs(heights[x + 1] - heights[x]);
+        ++steps;
+    }
+    double slope = steps > 0 ? std::atan(rise / steps) * 180.0 / 3.14159265358979 : 0.0;
+    std::printf("  %-22s %12d rows peak %7d cols base  %.1f deg mean slope\n", "Shape", peak, base, slope);
+}
+
+void BenchResistance(const SimulationBackend& world, const BenchConfig& cfg, float radius) {
+    float volatile sink = 0.0f;
+    auto start = Clock::now();
+    for (int i = 0; i < cfg.queries; ++i) {
+        float cx = static_cast<float>((i * 7919) % world.GetWidth());
+        float cy = static_cast<float>((i * 104729) % world.GetHeight());
+        sink = sink + world.GetResistance(cx, cy, radius);
+    }
+    double ns = ElapsedNs(start);
+
+    double cellsPerQuery = (2.0 * radius + 1.0) * (2.0 * radius + 1.0);
+    char label[32];
+    std::snprintf(label, sizeof(label), "GetResistance r=%.0f", radius);
+    std::printf("  %-22s %12.1f calls/s %10.3f ns/cell\n", label, cfg.queries * 1e9 / ns, ns / (cfg.queries * cellsPerQuery));
+}
+
+void BenchHaptics(SimulationBackend& world, const BenchConfig& cfg) {
+    HapticSystem haptics;
+    haptics.currentMode = HapticSystem::ControlMode::Mode_2DOF;
+    glm::vec2 center(world.GetWidth() * 0.5f, world.GetHeight() * 0.5f);
+    haptics.Recenter(center);
+
+    // Sweep the device back and forth through the middle of the scene
+    int calls = cfg.queries / 10 + 1;
+    float span = std::min(world.GetWidth(), world.GetHeight()) * 0.25f;
+    auto start = Clock::now();
+    for (int i = 0; i < calls; ++i) {
+        float t = static_cast<float>(i % 200) / 200.0f;
+        glm::vec2 pos = center + glm::vec2((t * 2.0f - 1.0f) * span, 0.0f);
+        haptics.Update(pos, 0.0f, true, world);
+    }
+    double ns = ElapsedNs(start);
+    std::printf("  %-22s %12.1f calls/s %10.1f ns/call\n", "HapticSystem::Update", calls * 1e9 / ns, ns / calls);
+}
+
+// Sub-ticks of a high-rate region the size the simulation thread uses around a radius 4
+// tool, in the middle of the scene
+void BenchRegion(SandSimulation& sim, const BenchConfig& cfg) {
+    constexpr int REACH = 16;
+    const int cx = sim.width / 2;
+    const int cy = sim.height / 2;
+    sim.SetRegion(DirtyRect{ cx - REACH, cy - REACH, cx + REACH, cy + REACH });
+    if (!sim.HasRegion()) return;
+
+    const DirtyRect& region = sim.GetRegion();
+    const double cells = static_cast<double>(region.maxX - region.minX + 1) * (region.maxY - region.minY + 1);
+    int calls = cfg.queries / 10 + 1;
+    auto start = Clock::now();
+    for (int i = 0; i < calls; ++i) sim.UpdateRegion();
+    double ns = ElapsedNs(start);
+    sim.SetRegion(DirtyRect{});
+    std::printf("  %-22s %12.1f ticks/s %10.3f ns/cell\n", "UpdateRegion", calls * 1e9 / ns, ns / (calls * cells));
+}
+
+// Bulk edits across the world, per call and per cell covered
+void BenchFill(SandSimulation& sim, const BenchConfig& cfg) {
+    const int w = sim.width;
+    const int h = sim.height;
+    const int calls = cfg.queries / 1000 + 1;
+    std::vector<PackedCell> prefab;
+    sim.ExportCells(prefab);
+
+    auto bench = [&](const char* name, double cells, auto&& edit) {
+        auto start = Clock::now();
+        for (int i = 0; i < calls; ++i) edit();
+        double ns = ElapsedNs(start);
+        std::printf("  %-22s %12.3f ms %10.3f ns/cell\n", name, ns * 1e-6 / calls, ns / (calls * cells));
+    };
+    const double area = static_cast<double>(w) * h;
+    const glm::vec2 center(w * 0.5f, h * 0.5f);
+    const float radius = std::min(w, h) * 0.25f;
+    const glm::vec2 corner(static_cast<float>(w - 1), static_cast<float>(h - 1));
+    bench("FillRect", area, [&] { sim.FillRect(0, 0, w - 1, h - 1, MaterialType::Sand); });
+    bench("ClearRect", area, [&] { sim.ClearRect(0, 0, w - 1, h - 1); });
+    bench("FillCircle", 3.14159265 * radius * radius, [&] { sim.FillCircle(center, radius, MaterialType::Water); });
+    bench("FillPolygon", area * 0.5, [&] {
+        sim.FillPolygon({ glm::vec2(0.0f, corner.y), corner, glm::vec2(center.x, 0.0f) }, MaterialType::WetSand, SOAK_THRESHOLD);
+    });
+    bench("FillLine r=4", glm::length(corner) * 8.0, [&] { sim.FillLine(glm::vec2(0.0f), corner, 4.0f, MaterialType::Sand); });
+    bench("BlitRegion", area, [&] { sim.BlitRegion(0, 0, w, h, prefab.data()); });
+    bench("StampRegion", area, [&] { sim.StampRegion(0, 0, w, h, prefab.data()); });
+}
+
+// Runs the scene in the particle backend: every occupied cell becomes a patch of grains
+void BenchParticles(const SandSimulation& sim, const BenchConfig& cfg) {
+    std::vector<PackedCell> cells;
+    sim.ExportCells(cells);
+    ParticleSimulation particles;
+    particles.seed = cfg.seed;
+    particles.threadCount = cfg.threads;
+    particles.LoadCells(sim.width, sim.height, cells);
+
+    for (int i = 0; i < cfg.warmup; ++i) particles.Step();
+    auto start = Clock::now();
+    for (int i = 0; i < cfg.ticks; ++i) particles.Step();
+    double ns = ElapsedNs(start);
+
+    double grainSteps = static_cast<double>(particles.GetGrainCount()) * particles.substeps * cfg.ticks;
+    std::printf("  %-22s %12.1f ticks/s %10.3f ns/grain-substep  grains %zu\n", "Step", cfg.ticks * 1e9 / ns,
+                grainSteps > 0.0 ? ns / grainSteps : 0.0, particles.GetGrainCount());
+    if (cfg.scene == Scene::Heap) BenchShape(particles);
+
+    for (float radius : { 2.0f, 4.0f, 10.0f, 20.0f }) BenchResistance(particles, cfg, radius);
+    BenchHaptics(particles, cfg);
+}
+
+void BenchSnapshot(const SandSimulation& sim, const BenchConfig& cfg) {
+    for (SnapshotEncoding encoding : { SnapshotEncoding::RunLength, SnapshotEncoding::Raw }) {
+        const char* name = encoding == SnapshotEncoding::Raw ? "raw" : "rle";
+        std::string path = cfg.snapshotPath + "." + name;
+
+        auto start = Clock::now();
+        if (!SaveSnapshot(path, sim, nullptr, encoding)) return;
+        double saveNs = ElapsedNs(start);
+
+        SandSimulation loaded;
+        start = Clock::now();
+        if (!LoadSnapshot(path, loaded, nullptr)) return;
+        double loadNs = ElapsedNs(start);
+
+        char label[32];
+        std::snprintf(label, sizeof(label), "Snapshot %s", name);
+        std::printf("  %-22s %12.3f ms save %10.3f ms load  %s\n", label, saveNs * 1e-6, loadNs * 1e-6,
+                    loaded.ComputeGridHash() == sim.ComputeGridHash() ? "match" : "MISMATCH");
+    }
+}
+
+void ConfigureSim(SandSimulation& sim, const BenchConfig& cfg) {
+    sim.chunkSleeping = cfg.chunkSleeping;
+    sim.threadCount = cfg.threads;
+    sim.engine = cfg.engine;
+    sim.worklistMode = cfg.worklistMode;
+    sim.waterMode = cfg.waterMode;
+    sim.multiResolution = cfg.multiResolution;
+    sim.heightfield = cfg.heightfield;
+    sim.refineFocus = glm::ivec2(sim.width / 2, sim.height / 2);
+}
+
+// Saves the run halfway through to a snapshot and a checkpoint, then finishes it live,
+// from the snapshot and from the checkpoint; all three must end on the same grid
+bool BenchCheckRestore(SandSimulation& sim, const BenchConfig& cfg) {
+    const int half = cfg.ticks / 2;
+    for (int i = 0; i < half; ++i) sim.Update();
+    HapticSystem haptics;
+    CheckpointTimeline timeline;
+    if (!SaveSnapshot(cfg.snapshotPath, sim, &haptics) || !timeline.Capture(sim, haptics)) return false;
+    for (int i = half; i < cfg.ticks; ++i) sim.Update();
+    const uint64_t live = sim.ComputeGridHash();
+
+    SandSimulation loaded(cfg.seed);
+    loaded.SetLayout(cfg.layout);
+    ConfigureSim(loaded, cfg);
+    if (!LoadSnapshot(cfg.snapshotPath, loaded, &haptics)) return false;
+    for (int i = half; i < cfg.ticks; ++i) loaded.Update();
+    const uint64_t snapshot = loaded.ComputeGridHash();
+
+    if (!timeline.Rewind(0, sim, haptics)) return false;
+    for (int i = half; i < cfg.ticks; ++i) sim.Update();
+    const uint64_t rewound = sim.ComputeGridHash();
+
+    std::printf("  %-22s live %016llx snapshot %016llx checkpoint %016llx\n", "Restore",
+                static_cast<unsigned long long>(live), static_cast<unsigned long long>(snapshot),
+                static_cast<unsigned long long>(rewound));
+    if (snapshot == live && rewound == live) return true;
+    std::fprintf(stderr, "[Error] a restored run ended on a different grid\n");
+    return false;
+}
+
+// Checkpoints a fresh scene every few ticks, then rewinds to the first checkpoint and
+// reruns; the rerun must end on the same grid
+void BenchCheckpoints(SandSimulation& sim, const BenchConfig& cfg) {
+    constexpr int INTERVAL_TICKS = 10;
+    if (sim.IsPaged()) return;
+    BuildScene(sim, cfg.scene);
+
+    CheckpointTimeline timeline;
+    timeline.capacity = cfg.ticks / INTERVAL_TICKS + 1;
+    HapticSystem haptics;
+    double captureNs = 0.0;
+    for (int i = 0; i <= cfg.ticks; ++i) {
+        if (i % INTERVAL_TICKS == 0) {
+            auto start = Clock::now();
+            timeline.Capture(sim, haptics);
+            captureNs += ElapsedNs(start);
+        }
+        if (i < cfg.ticks) sim.Update();
+    }
+    uint64_t hash = sim.ComputeGridHash();
+
+    auto start = Clock::now();
+    timeline.Rewind(0, sim, haptics);
+    double rewindNs = ElapsedNs(start);
+    for (int i = 0; i < cfg.ticks; ++i) sim.Update();
+
+    size_t count = timeline.GetCount();
+    double fullMiB = static_cast<double>(count) * sim.width * sim.height / 1048576.0;
+    std::printf("  %-22s %12.3f ms capture %10.3f ms rewind  %zu in %.2f MiB, %.2f MiB as full copies  %s\n", "Checkpoints",
+                captureNs * 1e-6 / count, rewindNs * 1e-6, count, timeline.GetBytes() / 1048576.0, fullMiB,
+                sim.ComputeGridHash() == hash ? "match" : "MISMATCH");
+}
+
+// Replays a recorded session as fast as possible; every run must end on the same grid
+int BenchReplay(const BenchConfig& cfg) {
+    std::printf("replay %s runs=%d\n", cfg.replayPath.c_str(), cfg.replayRuns);
+
+    uint64_t firstHash = 0;
+    for (int run = 0; run < cfg.replayRuns; ++run) {
+        SandSimulation sim;
+        HapticSystem haptics;
+        JournalReplayStats stats;
+        if (!ReplayJournal(cfg.replayPath, sim, haptics, &stats)) return 1;
+
+        uint64_t hash = sim.ComputeGridHash();
+        if (run == 0) firstHash = hash;
+        std::printf("  run %-3d %dx%d ticks=%llu region=%llu haptics=%llu edits=%llu  update %.3f ms  haptics %.3f ms  total %.3f ms"
+                    "  %.1f ticks/s  hash=%016llx%s\n",
+                    run, sim.width, sim.height, static_cast<unsigned long long>(stats.ticks),
+                    static_cast<unsigned long long>(stats.regionTicks), static_cast<unsigned long long>(stats.hapticUpdates), static_cast<unsigned long long>(stats.edits),
+                    stats.updateMs, stats.hapticsMs, stats.totalMs,
+                    stats.totalMs > 0.0 ? stats.ticks * 1000.0 / stats.totalMs : 0.0,
+                    static_cast<unsigned long long>(hash), hash == firstHash ? "" : "  MISMATCH");
+        if (hash != firstHash) return 1;
+    }
+    return 0;
+}
+
+bool ParseSize(const char* text, glm::ivec2& out) {
+    int w = 0, h = 0;
+    if (std::sscanf(text, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) return false;
+    out = glm::ivec2(w, h);
+    return true;
+}
+
+bool ParseArgs(int argc, char** argv, BenchConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue) {
+            glm::ivec2 size;
+            if (!ParseSize(argv[++i], size)) return false;
+            cfg.sizes.push_back(size);
+        } else if (arg == "--scene" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "pile") cfg.scene = Scene::Pile;
+            else if (name == "settled") cfg.scene = Scene::Settled;
+            else if (name == "mixed") cfg.scene = Scene::Mixed;
+            else if (name == "sparse") cfg.scene = Scene::Sparse;
+            else if (name == "basin") cfg.scene = Scene::Basin;
+            else if (name == "heap") cfg.scene = Scene::Heap;
+            else return false;
+        } else if (arg == "--ticks" && hasValue) {
+            cfg.ticks = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--warmup" && hasValue) {
+            cfg.warmup = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--queries" && hasValue) {
+            cfg.queries = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--threads" && hasValue) {
+            cfg.threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--engine" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "scan") cfg.engine = UpdateEngine::Scan;
+            else if (name == "bitboard") cfg.engine = UpdateEngine::Bitboard;
+            else if (name == "margolus") cfg.engine = UpdateEngine::Margolus;
+            else return false;
+        } else if (arg == "--worklist" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "auto") cfg.worklistMode = WorklistMode::Auto;
+            else if (name == "dense") cfg.worklistMode = WorklistMode::Dense;
+            else if (name == "sparse") cfg.worklistMode = WorklistMode::Sparse;
+            else return false;
+        } else if (arg == "--water" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "cellular") cfg.waterMode = WaterMode::Cellular;
+            else if (name == "hydrostatic") cfg.waterMode = WaterMode::Hydrostatic;
+            else return false;
+        } else if (arg == "--layout" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "rowmajor") cfg.layout = GridLayout::RowMajor;
+            else if (name == "tiled") cfg.layout = GridLayout::Tiled;
+            else if (name == "chunked") cfg.layout = GridLayout::Chunked;
+            else if (name == "zorder") cfg.layout = GridLayout::ZOrder;
+            else return false;
+        } else if (arg == "--backend" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "cellular") cfg.backend = BackendType::Cellular;
+            else if (name == "particles") cfg.backend = BackendType::Particles;
+            else return false;
+        } else if (arg == "--snapshot" && hasValue) {
+            cfg.snapshotPath = argv[++i];
+        } else if (arg == "--replay" && hasValue) {
+            cfg.replayPath = argv[++i];
+        } else if (arg == "--replay-runs" && hasValue) {
+            cfg.replayRuns = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--paged" && hasValue) {
+            cfg.pagedPath = argv[++i];
+        } else if (arg == "--seed" && hasValue) {
+            cfg.seed = std::strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--multires") {
+            cfg.multiResolution = true;
+        } else if (arg == "--heightfield") {
+            cfg.heightfield = true;
+        } else if (arg == "--checkpoints") {
+            cfg.checkpoints = true;
+        } else if (arg == "--expect-hash" && hasValue) {
+            cfg.checkHash = true;
+            cfg.expectHash = std::strtoull(argv[++i], nullptr, 16);
+        } else if (arg == "--check-restore") {
+            cfg.checkRestore = true;
+        } else if (arg == "--no-sleep") {
+            cfg.chunkSleeping = false;
+        } else {
+            return false;
+        }
+    }
+    if (cfg.checkHash && (cfg.sizes.size() != 1 || cfg.backend != BackendType::Cellular)) return false;
+    if (cfg.checkRestore && (cfg.sizes.size() != 1 || cfg.backend != BackendType::Cellular || cfg.snapshotPath.empty() ||
+                             !cfg.pagedPath.empty())) {
+        return false;
+    }
+    if (cfg.sizes.empty()) {
+        cfg.sizes = { {64, 64}, {256, 256}, {1024, 1024} };
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    if (!ParseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr, "Usage: %s [--size WxH]... [--scene pile|settled|mixed|sparse|basin|heap] [--ticks N] [--warmup N] [--queries N] [--no-sleep]\n"
+                     "       [--threads N] [--engine scan|bitboard|margolus] [--worklist auto|dense|sparse] [--seed N] [--paged FILE]\n"
+                     "       [--water cellular|hydrostatic] [--layout rowmajor|tiled|chunked|zorder] [--snapshot FILE]\n"
+                     "       [--backend cellular|particles] [--multires] [--heightfield] [--checkpoints] [--expect-hash HEX]\n"
+                     "       [--check-restore]\n"
+                     "       %s --replay FILE [--replay-runs N]\n", argv[0], argv[0]);
+        return 1;
+    }
+    if (!cfg.replayPath.empty()) return BenchReplay(cfg);
+
+    for (const glm::ivec2& size : cfg.sizes) {
+        SandSimulation sim(cfg.seed);
+        if (cfg.pagedPath.empty()) {
+            sim.Resize(size.x, size.y);
+            sim.SetLayout(cfg.layout);
+        } else {
+            // Each size gets its own file so reruns reopen a world of matching dimensions
+            std::string path = cfg.pagedPath + "." + std::to_string(size.x) + "x" + std::to_string(size.y);
+            if (!sim.OpenPagedWorld(path, size.x, size.y)) return 1;
+            sim.pagingFocus = glm::ivec2(size.x / 2, size.y / 2);
+        }
+        ConfigureSim(sim, cfg);
+
+        std::printf("%dx%d scene=%s engine=%s worklist=%s water=%s layout=%s ticks=%d threads=%d bytes/cell=%zu\n",
+                    size.x, size.y, SceneName(cfg.scene), EngineName(cfg.engine), WorklistName(cfg.worklistMode),
+                    WaterName(cfg.waterMode), LayoutName(sim.GetLayout()), cfg.ticks, cfg.threads,
+                    CellStorage::BYTES_PER_CELL);
+
+        auto start = Clock::now();
+        BuildScene(sim, cfg.scene);
+        std::printf("  %-22s %12.3f ms\n", "BuildScene", ElapsedNs(start) * 1e-6);
+        if (cfg.checkRestore) return BenchCheckRestore(sim, cfg) ? 0 : 1;
+        if (cfg.backend == BackendType::Particles) {
+            BenchParticles(sim, cfg);
+            continue;
+        }
+        BenchUpdate(sim, cfg);
+        if (cfg.checkHash) {
+            uint64_t hash = sim.ComputeGridHash();
+            if (hash == cfg.expectHash) return 0;
+            std::fprintf(stderr, "[Error] grid hash %016llx, expected %016llx\n", static_cast<unsigned long long>(hash),
+                         static_cast<unsigned long long>(cfg.expectHash));
+            return 1;
+        }
+        if (cfg.scene == Scene::Basin || cfg.scene == Scene::Heap) BenchSettle(sim, cfg.scene);
+        if (cfg.scene == Scene::Heap) BenchShape(sim);
+        if (sim.IsPaged()) {
+            sim.ReleaseColdChunks();
+            std::printf("  %-22s %12.1f MiB for a %.1f MiB world\n", "Process RSS", ResidentMiB(),
+                        static_cast<double>(size.x) * size.y * CellStorage::BYTES_PER_CELL / 1048576.0);
+        }
+
+        if (!cfg.snapshotPath.empty()) BenchSnapshot(sim, cfg);
+        if (cfg.checkpoints) BenchCheckpoints(sim, cfg);
+
+        BuildScene(sim, cfg.scene);
+        for (float radius : { 2.0f, 4.0f, 10.0f, 20.0f }) BenchResistance(sim, cfg, radius);
+
+        BenchHaptics(sim, cfg);
+        BenchRegion(sim, cfg);
+        BenchFill(sim, cfg);
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "core/bitboard_kernel.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SANDSIM_BITBOARD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace bitboard {
+
+namespace {
+
+uint64_t TailMask(int width, int word) {
+    int bits = width - word * WORD_BITS;
+    return bits >= WORD_BITS ? ~0ull : (1ull << bits) - 1;
+}
+
+void BuildMaskScalar(const uint8_t* row, int width, uint8_t material, bool occupancy, uint64_t* out) {
+    for (int w = 0; w < WordCount(width); ++w) {
+        uint64_t word = 0;
+        int count = std::min(WORD_BITS, width - w * WORD_BITS);
+        const uint8_t* cells = row + w * WORD_BITS;
+        for (int i = 0; i < count; ++i) {
+            uint8_t nibble = cells[i] & 0x0F;
+            bool hit = occupancy ? nibble != 0 : nibble == material;
+            word |= static_cast<uint64_t>(hit) << i;
+        }
+        out[w] = word;
+    }
+}
+
+#if SANDSIM_BITBOARD_X86
+__attribute__((target("avx2")))
+void BuildMaskAvx2(const uint8_t* row, int width, uint8_t material, bool occupancy, uint64_t* out) {
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0F);
+    const __m256i target = _mm256_set1_epi8(static_cast<char>(occupancy ? 0 : material));
+
+    int fullWords = width / WORD_BITS;
+    for (int w = 0; w < fullWords; ++w) {
+        const uint8_t* cells = row + w * WORD_BITS;
+        __m256i lo = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells)), nibbleMask);
+        __m256i hi = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + 32)), nibbleMask);
+        uint64_t loBits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, target)));
+        uint64_t hiBits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, target)));
+        uint64_t word = loBits | (hiBits << 32);
+        out[w] = occupancy ? ~word : word;
+    }
+    if (fullWords * WORD_BITS < width) {
+        BuildMaskScalar(row + fullWords * WORD_BITS, width - fullWords * WORD_BITS, material, occupancy, out + fullWords);
+    }
+}
+#endif
+
+void BuildMask(const uint8_t* row, int width, uint8_t material, bool occupancy, uint64_t* out) {
+#if SANDSIM_BITBOARD_X86
+    if (HasAvx2()) {
+        BuildMaskAvx2(row, width, material, occupancy, out);
+        return;
+    }
+#endif
+    BuildMaskScalar(row, width, material, occupancy, out);
+}
+
+}
+
+bool HasAvx2() {
+#if SANDSIM_BITBOARD_X86
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void BuildMaterialMask(const uint8_t* row, int width, uint8_t material, uint64_t* out) {
+    BuildMask(row, width, material, false, out);
+}
+
+void BuildOccupancyMask(const uint8_t* row, int width, uint64_t* out) {
+    BuildMask(row, width, 0, true, out);
+}
+
+void ComputeSandMoves(const uint64_t* sand, const uint64_t* belowOccupied, const uint64_t* belowWater,
+                      const uint64_t* random, int width, const SandMoves& out) {
+    int words = WordCount(width);
+
+    // Straight down first; the left plane temporarily holds the cells still free below
+    for (int w = 0; w < words; ++w) {
+        uint64_t empty = ~belowOccupied[w] & TailMask(width, w);
+        out.down[w] = sand[w] & empty;
+        out.swapDown[w] = sand[w] & belowWater[w];
+        out.left[w] = empty & ~out.down[w];
+    }
+
+    // Diagonals read the free plane one bit either side, so carry words along by hand
+    uint64_t prevFree = 0;
+    for (int w = 0; w < words; ++w) {
+        uint64_t free = out.left[w];
+        uint64_t nextFree = w + 1 < words ? out.left[w + 1] : 0;
+        uint64_t freeLeft = (free << 1) | (prevFree >> (WORD_BITS - 1));
+        uint64_t freeRight = (free >> 1) | (nextFree << (WORD_BITS - 1));
+
+        uint64_t blocked = sand[w] & ~out.down[w] & ~out.swapDown[w];
+        uint64_t canLeft = blocked & freeLeft;
+        uint64_t canRight = blocked & freeRight;
+        uint64_t both = canLeft & canRight;
+
+        out.left[w] = (canLeft & ~canRight) | (both & random[w]);
+        out.right[w] = (canRight & ~canLeft) | (both & ~random[w]);
+        prevFree = free;
+    }
+
+    // x and x + 2 both aiming at x + 1: the scan reaches x first, so its right move wins
+    for (int w = 0; w < words; ++w) {
+        uint64_t rightTwoOver = (out.right[w] << 2) | (w > 0 ? out.right[w - 1] >> (WORD_BITS - 2) : 0);
+        out.left[w] &= ~rightTwoOver;
+    }
+}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// --- Bitboard Kernel ---
+// Row-wide helpers for the bitboard engine. A row is a bit plane of 64-bit words where
+// bit x stands for column x. Bits at or past the row width are always zero.
+namespace bitboard {
+
+constexpr int WORD_BITS = 64;
+
+inline int WordCount(int width) {
+    return (width + WORD_BITS - 1) / WORD_BITS;
+}
+
+// Sets bit x for every packed cell in row[0, width) whose material nibble equals material
+void BuildMaterialMask(const uint8_t* row, int width, uint8_t material, uint64_t* out);
+
+// Sets bit x for every packed cell in row[0, width) that is not Empty
+void BuildOccupancyMask(const uint8_t* row, int width, uint64_t* out);
+
+// True when BuildMaterialMask/BuildOccupancyMask run the AVX2 path on this CPU
+bool HasAvx2();
+
+struct SandMoves {
+    uint64_t* down;
+    uint64_t* swapDown;
+    uint64_t* left;
+    uint64_t* right;
+};
+
+// Dry-sand rules for one row against the already updated row below, matching UpdateSand:
+// fall into empty, sink through water, else slide diagonally (random when both are free).
+// Diagonal movers that would land on the same cell resolve in scan order: the
+// right-mover wins and the left-mover stays put for this tick.
+void ComputeSandMoves(const uint64_t* sand, const uint64_t* belowOccupied, const uint64_t* belowWater,
+                      const uint64_t* random, int width, const SandMoves& out);
+
+}
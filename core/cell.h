@@ -0,0 +1,21 @@
+#pragma once
+
+// --- Constants ---
+constexpr int INITIAL_WIDTH = 60;
+constexpr int INITIAL_HEIGHT = 60;
+constexpr int SOAK_THRESHOLD = 2;
+constexpr float TICK_DELAY_DEFAULT = 16.0f;
+
+// --- Types ---
+enum class MaterialType {
+    Empty = 0,
+    Sand,
+    WetSand,
+    Water,
+    Count
+};
+
+struct Cell {
+    MaterialType type = MaterialType::Empty;
+    int soak = 0;
+};
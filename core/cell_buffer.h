@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "core/mapped_region.h"
+
+// --- Cell Buffer ---
+// Flat array of per-cell values that lives either on the heap or in a MappedRegion.
+// Mapped buffers can hand pages back to the kernel, which is what lets a paged world
+// be larger than RAM.
+template <typename T>
+class CellBuffer {
+    static_assert(std::is_trivially_copyable_v<T>, "cell buffers are copied and zeroed bytewise");
+
+private:
+    std::vector<T> m_heap;
+    MappedRegion m_region;
+    T* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_offsetBytes = 0;
+
+    [[nodiscard]] static bool IsZero(const T& value) {
+        T zero{};
+        return std::memcmp(&value, &zero, sizeof(T)) == 0;
+    }
+
+public:
+    // Large zero-filled buffers take lazily zeroed pages instead of clearing them up front
+    static constexpr size_t LAZY_ZERO_BYTES = 1 << 20;
+
+    void Assign(size_t count, const T& value) {
+        if (count * sizeof(T) >= LAZY_ZERO_BYTES && IsZero(value) && MapAnonymous(count)) return;
+
+        m_region.Unmap();
+        m_heap.assign(count, value);
+        m_data = m_heap.data();
+        m_size = count;
+        m_offsetBytes = 0;
+    }
+
+    // Cells start `headerBytes` into the file; the header is left to the caller
+    bool MapFile(const std::string& path, size_t count, size_t headerBytes) {
+        MappedRegion region;
+        if (!region.MapFile(path, headerBytes + count * sizeof(T))) return false;
+        Adopt(std::move(region), count, headerBytes);
+        return true;
+    }
+
+    // Copy-on-write view of `count` cells starting `offsetBytes` into an existing file
+    bool MapFileCopy(const std::string& path, size_t count, size_t offsetBytes) {
+        MappedRegion region;
+        if (!region.MapFileCopy(path)) return false;
+        if (region.Bytes() < offsetBytes + count * sizeof(T)) return false;
+        Adopt(std::move(region), count, offsetBytes);
+        return true;
+    }
+
+    bool MapAnonymous(size_t count) {
+        MappedRegion region;
+        if (!region.MapAnonymous(count * sizeof(T))) return false;
+        Adopt(std::move(region), count, 0);
+        return true;
+    }
+
+    void Adopt(MappedRegion&& region, size_t count, size_t offsetBytes) {
+        m_heap = {};
+        m_region = std::move(region);
+        m_data = reinterpret_cast<T*>(static_cast<char*>(m_region.Data()) + offsetBytes);
+        m_size = count;
+        m_offsetBytes = offsetBytes;
+    }
+
+    void Fill(const T& value) {
+        // Zeroing a mapping frees its pages instead of touching every one of them
+        if (m_region.IsMapped() && IsZero(value)) m_region.Zero(m_offsetBytes, m_size * sizeof(T));
+        else std::fill(m_data, m_data + m_size, value);
+    }
+
+    void Release(size_t first, size_t count) {
+        if (m_region.IsMapped()) m_region.Release(m_offsetBytes + first * sizeof(T), count * sizeof(T));
+    }
+
+    void Sync() { m_region.Sync(); }
+
+    [[nodiscard]] bool IsMapped() const { return m_region.IsMapped(); }
+    [[nodiscard]] void* Header() const { return m_region.Data(); }
+    [[nodiscard]] size_t Size() const { return m_size; }
+    [[nodiscard]] T* Data() { return m_data; }
+    [[nodiscard]] const T* Data() const { return m_data; }
+
+    T& operator[](size_t i) { return m_data[i]; }
+    const T& operator[](size_t i) const { return m_data[i]; }
+};
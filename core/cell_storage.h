@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "core/cell.h"
+#include "core/cell_buffer.h"
+
+// --- Cell Storage ---
+// Dense index-addressed cell arrays. Callers only see decoded Cells; the packed
+// variant keeps material in the low nibble and soak in the high nibble of one byte.
+// Either can live on the heap or in a memory-mapped file (see CellBuffer); an all-zero
+// cell is Empty, so a fresh file is an empty world.
+
+using PackedCell = uint8_t;
+
+static_assert(static_cast<int>(MaterialType::Count) <= 16, "material must fit in 4 bits");
+static_assert(SOAK_THRESHOLD < 16, "soak must fit in 4 bits");
+
+constexpr PackedCell PackCell(MaterialType type, int soak) {
+    return static_cast<PackedCell>(static_cast<int>(type) | (soak << 4));
+}
+
+constexpr PackedCell PackCell(const Cell& cell) {
+    return PackCell(cell.type, cell.soak);
+}
+
+constexpr Cell UnpackCell(PackedCell packed) {
+    return Cell{ static_cast<MaterialType>(packed & 0x0F), packed >> 4 };
+}
+
+// A known material with a soak the rules can reach, for cells read from outside
+constexpr bool IsValidPackedCell(PackedCell packed) {
+    return (packed & 0x0F) < static_cast<int>(MaterialType::Count) && (packed >> 4) <= SOAK_THRESHOLD;
+}
+
+class WideCellStorage {
+private:
+    CellBuffer<Cell> m_cells;
+
+public:
+    static constexpr size_t BYTES_PER_CELL = sizeof(Cell);
+
+    void Assign(size_t count) { m_cells.Assign(count, Cell{}); }
+    bool MapFile(const std::string& path, size_t count, size_t headerBytes) { return m_cells.MapFile(path, count, headerBytes); }
+    void Fill(const Cell& cell) { m_cells.Fill(cell); }
+    void Release(size_t first, size_t count) { m_cells.Release(first, count); }
+    void Sync() { m_cells.Sync(); }
+    [[nodiscard]] void* Header() const { return m_cells.Header(); }
+    [[nodiscard]] size_t Size() const { return m_cells.Size(); }
+
+    [[nodiscard]] Cell Load(size_t i) const { return m_cells[i]; }
+    [[nodiscard]] MaterialType Type(size_t i) const { return m_cells[i].type; }
+    void Store(size_t i, const Cell& cell) { m_cells[i] = cell; }
+
+    void Move(size_t from, size_t to) {
+        m_cells[to] = m_cells[from];
+        m_cells[from] = Cell{};
+    }
+
+    void Swap(size_t a, size_t b) { std::swap(m_cells[a], m_cells[b]); }
+
+    void CopyPacked(PackedCell* out) const {
+        for (size_t i = 0; i < m_cells.Size(); ++i) out[i] = PackCell(m_cells[i]);
+    }
+
+    // Ranges of `count` cells from index `first`, e.g. a row span of a row-major grid
+    [[nodiscard]] size_t CountOccupied(size_t first, size_t count) const {
+        size_t occupied = 0;
+        for (size_t i = first; i < first + count; ++i) occupied += m_cells[i].type != MaterialType::Empty;
+        return occupied;
+    }
+    void FillRange(size_t first, size_t count, const Cell& cell) { std::fill(&m_cells[first], &m_cells[first] + count, cell); }
+    void StorePacked(size_t first, size_t count, const PackedCell* cells) {
+        for (size_t i = 0; i < count; ++i) m_cells[first + i] = UnpackCell(cells[i]);
+    }
+    // Stores only the occupied cells; returns how many were stored over empty ones
+    int64_t StampPacked(size_t first, size_t count, const PackedCell* cells) {
+        int64_t added = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const Cell cell = UnpackCell(cells[i]);
+            if (cell.type == MaterialType::Empty) continue;
+            added += m_cells[first + i].type == MaterialType::Empty;
+            m_cells[first + i] = cell;
+        }
+        return added;
+    }
+};
+
+class PackedCellStorage {
+private:
+    CellBuffer<PackedCell> m_cells;
+
+public:
+    static constexpr size_t BYTES_PER_CELL = sizeof(PackedCell);
+
+    void Assign(size_t count) { m_cells.Assign(count, 0); }
+    bool MapFile(const std::string& path, size_t count, size_t headerBytes) { return m_cells.MapFile(path, count, headerBytes); }
+    void Fill(const Cell& cell) { m_cells.Fill(PackCell(cell)); }
+    void Release(size_t first, size_t count) { m_cells.Release(first, count); }
+    void Sync() { m_cells.Sync(); }
+    [[nodiscard]] void* Header() const { return m_cells.Header(); }
+    [[nodiscard]] size_t Size() const { return m_cells.Size(); }
+
+    [[nodiscard]] Cell Load(size_t i) const { return UnpackCell(m_cells[i]); }
+    [[nodiscard]] MaterialType Type(size_t i) const { return static_cast<MaterialType>(m_cells[i] & 0x0F); }
+    void Store(size_t i, const Cell& cell) { m_cells[i] = PackCell(cell); }
+
+    void Move(size_t from, size_t to) {
+        m_cells[to] = m_cells[from];
+        m_cells[from] = 0;
+    }
+
+    void Swap(size_t a, size_t b) { std::swap(m_cells[a], m_cells[b]); }
+
+    void CopyPacked(PackedCell* out) const { std::copy(m_cells.Data(), m_cells.Data() + m_cells.Size(), out); }
+
+    // Ranges of `count` cells from index `first`, e.g. a row span of a row-major grid;
+    // byte loops the compiler vectorizes, and a memset and memcpy
+    [[nodiscard]] size_t CountOccupied(size_t first, size_t count) const {
+        size_t occupied = 0;
+        for (size_t i = first; i < first + count; ++i) occupied += (m_cells[i] & 0x0F) != 0;
+        return occupied;
+    }
+    void FillRange(size_t first, size_t count, const Cell& cell) { std::fill(&m_cells[first], &m_cells[first] + count, PackCell(cell)); }
+    void StorePacked(size_t first, size_t count, const PackedCell* cells) { std::copy(cells, cells + count, &m_cells[first]); }
+    // Stores only the occupied cells; returns how many were stored over empty ones.
+    // Branch-free, so it vectorizes however the occupied cells are scattered.
+    int64_t StampPacked(size_t first, size_t count, const PackedCell* cells) {
+        int64_t added = 0;
+        PackedCell* out = &m_cells[first];
+        for (size_t i = 0; i < count; ++i) {
+            const bool solid = (cells[i] & 0x0F) != 0;
+            added += solid & ((out[i] & 0x0F) == 0);
+            out[i] = solid ? cells[i] : out[i];
+        }
+        return added;
+    }
+
+    [[nodiscard]] const PackedCell* Data() const { return m_cells.Data(); }
+
+    // Takes over row-major packed cells as they are, e.g. a mapped snapshot
+    void Adopt(CellBuffer<PackedCell>&& cells) { m_cells = std::move(cells); }
+};
+
+#if SANDSIM_PACKED_CELLS
+using CellStorage = PackedCellStorage;
+#else
+using CellStorage = WideCellStorage;
+#endif
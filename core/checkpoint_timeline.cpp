@@ -0,0 +1,125 @@
+#include "core/checkpoint_timeline.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "core/cell_buffer.h"
+
+namespace {
+
+// Empty chunks, e.g. the sky above a pile, all share one copy that is never counted
+const std::shared_ptr<const CheckpointTimeline::ChunkCells>& EmptyChunk() {
+    static const auto empty = std::make_shared<const CheckpointTimeline::ChunkCells>();
+    return empty;
+}
+
+}
+
+void CheckpointTimeline::ReleaseChunks(std::vector<std::shared_ptr<const ChunkCells>>& chunks) {
+    // A table holds each chunk other than the empty one at most once
+    for (const auto& chunk : chunks) {
+        if (chunk != EmptyChunk() && chunk.use_count() == 1) --m_chunkCopies;
+    }
+    chunks.clear();
+}
+
+bool CheckpointTimeline::Capture(SandSimulation& sim, const HapticSystem& haptics) {
+    if (sim.IsPaged()) {
+        std::cerr << "[Error] Capture: paged worlds cannot be checkpointed" << std::endl;
+        return false;
+    }
+
+    Checkpoint checkpoint;
+    checkpoint.width = sim.width;
+    checkpoint.height = sim.height;
+    checkpoint.chunksX = sim.GetChunksX();
+    checkpoint.seed = sim.seed;
+    checkpoint.tickCount = sim.GetTickCount();
+    checkpoint.haptics = haptics;
+    if (sim.GetBedColumnCount() > 0) sim.ExportBeds(checkpoint.bedTops, checkpoint.bedFlags);
+
+    // Chunks nothing woke since the last capture are shared as they are; woken ones are
+    // compared, since most wakes leave the cells as they were
+    const size_t chunkCount = static_cast<size_t>(sim.GetChunksX()) * sim.GetChunksY();
+    sim.TakeEditedChunks(m_edited);
+    const bool diff = m_baseWidth == sim.width && m_baseHeight == sim.height && m_base.size() == chunkCount;
+    checkpoint.chunks.resize(chunkCount);
+    ChunkCells cells;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        if (diff && !m_edited[chunk]) {
+            checkpoint.chunks[chunk] = m_base[chunk];
+            continue;
+        }
+        sim.ExportChunk(static_cast<int>(chunk % checkpoint.chunksX), static_cast<int>(chunk / checkpoint.chunksX), cells.data());
+        if (diff && *m_base[chunk] == cells) {
+            checkpoint.chunks[chunk] = m_base[chunk];
+        } else if (cells == *EmptyChunk()) {
+            checkpoint.chunks[chunk] = EmptyChunk();
+        } else {
+            checkpoint.chunks[chunk] = std::make_shared<const ChunkCells>(cells);
+            ++m_chunkCopies;
+        }
+    }
+
+    ReleaseChunks(m_base);
+    m_base = checkpoint.chunks;
+    m_baseWidth = checkpoint.width;
+    m_baseHeight = checkpoint.height;
+
+    m_checkpoints.push_back(std::move(checkpoint));
+    while (m_checkpoints.size() > std::max<size_t>(capacity, 1)) {
+        ReleaseChunks(m_checkpoints.front().chunks);
+        m_checkpoints.pop_front();
+    }
+    return true;
+}
+
+bool CheckpointTimeline::Rewind(size_t index, SandSimulation& sim, HapticSystem& haptics) {
+    if (index >= m_checkpoints.size()) {
+        std::cerr << "[Error] Rewind: no checkpoint " << index << std::endl;
+        return false;
+    }
+    const Checkpoint& checkpoint = m_checkpoints[index];
+
+    CellBuffer<PackedCell> cells;
+    cells.Assign(static_cast<size_t>(checkpoint.width) * checkpoint.height, 0);
+    for (size_t chunk = 0; chunk < checkpoint.chunks.size(); ++chunk) {
+        const int x0 = static_cast<int>(chunk % checkpoint.chunksX) * CHUNK_SIZE;
+        const int y0 = static_cast<int>(chunk / checkpoint.chunksX) * CHUNK_SIZE;
+        const int columns = std::min(CHUNK_SIZE, checkpoint.width - x0);
+        const int rows = std::min(CHUNK_SIZE, checkpoint.height - y0);
+        const PackedCell* src = checkpoint.chunks[chunk]->data();
+        for (int row = 0; row < rows; ++row) {
+            std::copy(src + row * CHUNK_SIZE, src + row * CHUNK_SIZE + columns,
+                      cells.Data() + static_cast<size_t>(y0 + row) * checkpoint.width + x0);
+        }
+    }
+
+    sim.seed = checkpoint.seed;
+    sim.LoadCells(checkpoint.width, checkpoint.height, std::move(cells));
+    sim.SetTickCount(checkpoint.tickCount);
+    if (!checkpoint.bedTops.empty()) sim.LoadBeds(checkpoint.bedTops, checkpoint.bedFlags);
+
+    // The tool picks up where it was, with whatever configuration it has now
+    haptics.proxyPos = checkpoint.haptics.proxyPos;
+    haptics.devicePos = checkpoint.haptics.devicePos;
+    haptics.anchorPos = checkpoint.haptics.anchorPos;
+    haptics.smoothedResistance = checkpoint.haptics.smoothedResistance;
+    haptics.currentForce1D = checkpoint.haptics.currentForce1D;
+    haptics.rawInputVal = checkpoint.haptics.rawInputVal;
+
+    // Loading woke every chunk, so the next capture compares each against this one
+    ReleaseChunks(m_base);
+    m_base = checkpoint.chunks;
+    m_baseWidth = checkpoint.width;
+    m_baseHeight = checkpoint.height;
+    return true;
+}
+
+void CheckpointTimeline::Clear() {
+    m_checkpoints.clear();
+    m_base.clear();
+    m_baseWidth = 0;
+    m_baseHeight = 0;
+    m_chunkCopies = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "core/cell_storage.h"
+#include "core/haptic_system.h"
+#include "core/sand_simulation.h"
+
+// --- Checkpoint Timeline ---
+// In-memory checkpoints of a simulation for rewinding, e.g. to rerun the same pile with
+// different tool settings. A checkpoint is a table of shared, immutable chunks of packed
+// cells. Capturing copies only the chunks that changed since the previous capture and
+// shares the rest, so memory grows with what changed rather than with the number of
+// checkpoints times the grid size. Rewinding restores the cells, the RNG state (seed and
+// tick), any heightfield beds and the tool's motion; settings, including the tool's, stay
+// as they are.
+
+class CheckpointTimeline {
+public:
+    using ChunkCells = std::array<PackedCell, CHUNK_CELLS>;
+
+    struct Checkpoint {
+        int width = 0;
+        int height = 0;
+        int chunksX = 0;
+        uint64_t seed = 0;
+        uint64_t tickCount = 0;
+        HapticSystem haptics;
+        std::vector<std::shared_ptr<const ChunkCells>> chunks;
+        // Per column, so kept whole; empty without beds
+        std::vector<int32_t> bedTops;
+        std::vector<uint8_t> bedFlags;
+    };
+
+private:
+    std::deque<Checkpoint> m_checkpoints;
+    // Chunks of the world as of the last capture or rewind, which the next capture diffs
+    // against when the world still has the same dimensions
+    std::vector<std::shared_ptr<const ChunkCells>> m_base;
+    int m_baseWidth = 0;
+    int m_baseHeight = 0;
+    std::vector<uint8_t> m_edited;
+    size_t m_chunkCopies = 0;
+
+    // Drops a chunk table, uncounting the chunks no one else holds
+    void ReleaseChunks(std::vector<std::shared_ptr<const ChunkCells>>& chunks);
+
+public:
+    // The oldest checkpoint is dropped beyond this many
+    size_t capacity = 64;
+
+    // Paged worlds are larger than RAM and cannot be checkpointed
+    bool Capture(SandSimulation& sim, const HapticSystem& haptics);
+    // Restores checkpoint `index`, oldest first. Later checkpoints are kept, so a run
+    // can be rewound and branched repeatedly.
+    bool Rewind(size_t index, SandSimulation& sim, HapticSystem& haptics);
+    void Clear();
+
+    [[nodiscard]] size_t GetCount() const { return m_checkpoints.size(); }
+    [[nodiscard]] const Checkpoint& Get(size_t index) const { return m_checkpoints[index]; }
+    // Distinct chunks held across all checkpoints, and their bytes
+    [[nodiscard]] size_t GetChunkCopies() const { return m_chunkCopies; }
+    [[nodiscard]] size_t GetBytes() const { return m_chunkCopies * sizeof(ChunkCells); }
+};
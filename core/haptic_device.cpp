@@ -0,0 +1,83 @@
+#include "core/haptic_device.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <serial/serial.h>
+
+namespace {
+
+double SecondsNow() {
+    using Clock = std::chrono::steady_clock;
+    static const Clock::time_point start = Clock::now();
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+}
+
+HapticDevice::HapticDevice() = default;
+
+HapticDevice::~HapticDevice() { Disconnect(); }
+
+bool HapticDevice::Connect() {
+    try {
+        // Timeout(0) = Non-blocking
+        m_serial = std::make_unique<serial::Serial>(port, baud, serial::Timeout::simpleTimeout(0));
+
+        if (m_serial->isOpen()) {
+            connected = true;
+            m_currentPositionMeters = 0.0f;
+            m_serial->flushInput();
+            return true;
+        }
+        return false;
+    } catch (const std::exception& e) {
+        std::cerr << "[Error] Connect: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void HapticDevice::Disconnect() {
+    if (m_serial && m_serial->isOpen()) {
+        try {
+            m_serial->write("F 0.0\n");
+            m_serial->close();
+        } catch (...) {}
+    }
+    m_serial.reset();
+    connected = false;
+}
+
+void HapticDevice::Sync(float forceOutputNewtons) {
+    if (!connected || !m_serial) return;
+
+    // Read available data
+    int maxReads = 50;
+    try {
+        while (m_serial->available() && maxReads-- > 0) {
+            std::string line = m_serial->readline();
+            if (line.length() > 4 && line.back() == '\n') {
+                if (line[0] == 'P') {
+                    try {
+                        m_currentPositionMeters = std::stof(line.substr(2));
+                    } catch (...) {}
+                }
+            }
+        }
+    } catch (...) {}
+
+    // Write force data (rate limited or change threshold)
+    double currentTime = SecondsNow();
+    if (std::abs(forceOutputNewtons - m_lastSentForce) > 0.005f || (currentTime - m_lastSendTime) > 0.05) {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(5) << "F " << forceOutputNewtons << "\n";
+        try {
+            m_serial->write(ss.str());
+            m_lastSentForce = forceOutputNewtons;
+            m_lastSendTime = currentTime;
+        } catch (...) {}
+    }
+}
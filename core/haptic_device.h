@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace serial { class Serial; }
+
+// --- Haptic Device Communication Class ---
+class HapticDevice {
+private:
+    std::unique_ptr<serial::Serial> m_serial;
+    float m_currentPositionMeters = 0.0f;
+    float m_lastSentForce = -999.0f;
+    double m_lastSendTime = 0.0;
+
+public:
+    std::string port = "/dev/ttyUSB0";
+    unsigned long baud = 115200;
+    bool connected = false;
+
+    HapticDevice();
+    ~HapticDevice();
+
+    // Disable copying
+    HapticDevice(const HapticDevice&) = delete;
+    HapticDevice& operator=(const HapticDevice&) = delete;
+
+    bool Connect();
+    void Disconnect();
+    void Sync(float forceOutputNewtons);
+
+    [[nodiscard]] float GetPositionMeters() const {
+        return m_currentPositionMeters;
+    }
+};
@@ -0,0 +1,55 @@
+#include "core/haptic_system.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "core/simulation_backend.h"
+
+void HapticSystem::Update(const glm::vec2& mousePos, float rawInputMeters, bool isMouseInput, SimulationBackend& sim) {
+    if (currentMode == ControlMode::Mode_2DOF) {
+        devicePos = mousePos;
+        currentForce1D = 0.0f;
+    } else {
+        if (isMouseInput) {
+            if (currentAxis == AxisMode::X_Axis) {
+                rawInputVal = (mousePos.x - anchorPos.x) / hapkitScale;
+            } else {
+                rawInputVal = (mousePos.y - anchorPos.y) / hapkitScale;
+            }
+        } else {
+            rawInputVal = rawInputMeters;
+        }
+
+        // Clamping
+        rawInputVal = std::max(-0.08f, std::min(0.08f, rawInputVal));
+
+        if (currentAxis == AxisMode::X_Axis) {
+            devicePos = glm::vec2(anchorPos.x + rawInputVal * hapkitScale, anchorPos.y);
+        } else {
+            devicePos = glm::vec2(anchorPos.x, anchorPos.y + rawInputVal * hapkitScale);
+        }
+    }
+
+    // Low Pass Filter on Resistance
+    float rawResistance = sim.GetResistance(proxyPos.x, proxyPos.y, radius);
+    constexpr float alpha = 0.2f;
+    smoothedResistance = smoothedResistance * (1.0f - alpha) + rawResistance * alpha;
+
+    float viscosity = 1.0f / (1.0f + (smoothedResistance * frictionCoef));
+
+    // Move Proxy
+    glm::vec2 diff = devicePos - proxyPos;
+    proxyPos += diff * viscosity;
+
+    sim.Displace(proxyPos, radius);
+
+    // Force Calculation (Spring)
+    glm::vec2 forceVec = (proxyPos - devicePos) * -springK;
+
+    if (glm::length(forceVec) < 0.025f) forceVec = glm::vec2(0.0f);
+    force = forceVec;
+
+    if (currentMode == ControlMode::Mode_1DOF) {
+        currentForce1D = (currentAxis == AxisMode::X_Axis) ? forceVec.x : forceVec.y;
+    }
+}
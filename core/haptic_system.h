@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+class SimulationBackend;
+
+// --- Haptic System ---
+class HapticSystem {
+public:
+    enum class AxisMode { X_Axis, Y_Axis };
+    enum class ControlMode { Mode_1DOF, Mode_2DOF };
+
+    // State
+    glm::vec2 proxyPos  = { 30.0f, 30.0f };
+    glm::vec2 devicePos = { 30.0f, 30.0f };
+    glm::vec2 anchorPos = { 30.0f, 30.0f };
+    float smoothedResistance = 0.0f;
+    float currentForce1D = 0.0f;
+    glm::vec2 force = { 0.0f, 0.0f };  // Spring force on the device, in either mode
+    float rawInputVal = 0.0f;
+
+    // Configuration
+    AxisMode  currentAxis = AxisMode::X_Axis;
+    ControlMode currentMode = ControlMode::Mode_1DOF;
+    float radius = 4.0f;
+    float frictionCoef = 5.0f;
+    float hapkitScale = 500.0f;
+    float springK = 0.5f;
+
+    void Recenter(const glm::vec2& newCenter) {
+        anchorPos = newCenter;
+        proxyPos = newCenter;
+        devicePos = newCenter;
+        rawInputVal = 0.0f;
+    }
+
+    // Drives either backend; the proxy pushes material out of its way every update
+    void Update(const glm::vec2& mousePos, float rawInputMeters, bool isMouseInput, SimulationBackend& sim);
+};
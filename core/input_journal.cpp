@@ -0,0 +1,368 @@
+#include "core/input_journal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <type_traits>
+
+#include "core/haptic_system.h"
+#include "core/mapped_region.h"
+#include "core/sand_simulation.h"
+#include "core/snapshot_file.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr char JOURNAL_MAGIC[8] = { 'S', 'A', 'N', 'D', 'J', 'R', 'N', 'L' };
+constexpr uint32_t JOURNAL_VERSION = 8;
+constexpr size_t JOURNAL_HEADER_BYTES = sizeof(JOURNAL_MAGIC) + sizeof(uint32_t);
+
+template <typename T>
+void Put(std::vector<uint8_t>& out, T value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Bounds-checked reads from a journal payload
+class ByteReader {
+private:
+    const uint8_t* m_data;
+    size_t m_left;
+
+public:
+    ByteReader(const uint8_t* data, size_t bytes) : m_data(data), m_left(bytes) {}
+
+    template <typename T>
+    bool Get(T& out) {
+        if (m_left < sizeof(T)) return false;
+        std::memcpy(&out, m_data, sizeof(T));
+        m_data += sizeof(T);
+        m_left -= sizeof(T);
+        return true;
+    }
+
+    [[nodiscard]] bool Empty() const { return m_left == 0; }
+};
+
+std::vector<uint8_t> EncodeSettings(const SimSettings& settings) {
+    std::vector<uint8_t> out;
+    Put(out, settings.tickDelayMs);
+    Put(out, settings.speedMultiplier);
+    Put(out, settings.maxCatchUpMs);
+    Put(out, static_cast<uint8_t>(settings.chunkSleeping));
+    Put(out, static_cast<int32_t>(settings.threadCount));
+    Put(out, static_cast<uint8_t>(settings.engine));
+    Put(out, static_cast<uint8_t>(settings.worklistMode));
+    Put(out, static_cast<uint8_t>(settings.waterMode));
+    Put(out, static_cast<uint8_t>(settings.layout));
+    Put(out, static_cast<uint8_t>(settings.multiResolution));
+    Put(out, static_cast<uint8_t>(settings.heightfield));
+    Put(out, static_cast<uint8_t>(settings.axis));
+    Put(out, static_cast<uint8_t>(settings.mode));
+    Put(out, settings.radius);
+    Put(out, settings.frictionCoef);
+    Put(out, settings.hapkitScale);
+    Put(out, settings.springK);
+    return out;
+}
+
+bool DecodeSettings(ByteReader& in, SimSettings& settings) {
+    uint8_t chunkSleeping, engine, worklistMode, waterMode, layout, multiResolution, heightfield, axis, mode;
+    int32_t threadCount;
+    bool ok = in.Get(settings.tickDelayMs) && in.Get(settings.speedMultiplier) && in.Get(settings.maxCatchUpMs) &&
+              in.Get(chunkSleeping) && in.Get(threadCount) && in.Get(engine) && in.Get(worklistMode) &&
+              in.Get(waterMode) && in.Get(layout) && in.Get(multiResolution) && in.Get(heightfield) &&
+              in.Get(axis) && in.Get(mode) && in.Get(settings.radius) && in.Get(settings.frictionCoef) &&
+              in.Get(settings.hapkitScale) && in.Get(settings.springK);
+    if (!ok || threadCount < 1 || engine >= static_cast<uint8_t>(UpdateEngine::Count) ||
+        worklistMode >= static_cast<uint8_t>(WorklistMode::Count) ||
+        waterMode >= static_cast<uint8_t>(WaterMode::Count) || layout >= static_cast<uint8_t>(GridLayout::Count)) {
+        return false;
+    }
+
+    settings.chunkSleeping = chunkSleeping != 0;
+    // The result does not depend on the thread count, so a trace from a bigger machine
+    // replays on the cores this one has
+    settings.threadCount = std::min(static_cast<int>(threadCount),
+                                    std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+    settings.engine = static_cast<UpdateEngine>(engine);
+    settings.worklistMode = static_cast<WorklistMode>(worklistMode);
+    settings.waterMode = static_cast<WaterMode>(waterMode);
+    settings.layout = static_cast<GridLayout>(layout);
+    settings.multiResolution = multiResolution != 0;
+    settings.heightfield = heightfield != 0;
+    settings.axis = static_cast<HapticSystem::AxisMode>(axis);
+    settings.mode = static_cast<HapticSystem::ControlMode>(mode);
+    return true;
+}
+
+// Where the world after a journal's n-th snapshot load is kept
+std::string LoadedSnapshotPath(const std::string& journalPath, uint32_t load) {
+    return journalPath + "." + std::to_string(load) + ".snap";
+}
+
+double ElapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+}
+
+// --- Recording ---
+
+JournalRecorder::~JournalRecorder() { Stop(); }
+
+bool JournalRecorder::Start(const std::string& path, const SandSimulation& sim, const HapticSystem& haptics,
+                            const SimSettings& settings) {
+    Stop();
+
+    if (!SaveSnapshot(path + ".snap", sim, &haptics)) return false;
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) {
+        std::cerr << "[Error] JournalRecorder: cannot create " << path << std::endl;
+        return false;
+    }
+    std::fwrite(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC), 1, m_file);
+    std::fwrite(&JOURNAL_VERSION, sizeof(JOURNAL_VERSION), 1, m_file);
+    m_path = path;
+    m_loadCount = 0;
+
+    m_lastSettings.clear();
+    RecordSettings(settings);
+    return true;
+}
+
+void JournalRecorder::Stop() {
+    if (!m_file) return;
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void JournalRecorder::WriteEvent(JournalEvent event, const std::vector<uint8_t>& payload) {
+    std::fputc(static_cast<int>(event), m_file);
+    if (!payload.empty()) std::fwrite(payload.data(), 1, payload.size(), m_file);
+}
+
+void JournalRecorder::RecordTick() {
+    if (m_file) std::fputc(static_cast<int>(JournalEvent::Tick), m_file);
+}
+
+void JournalRecorder::RecordHaptics(const glm::vec2& mousePos, float rawInputMeters, bool isMouseInput) {
+    if (!m_file) return;
+    std::vector<uint8_t> payload;
+    Put(payload, mousePos.x);
+    Put(payload, mousePos.y);
+    Put(payload, rawInputMeters);
+    Put(payload, static_cast<uint8_t>(isMouseInput));
+    WriteEvent(JournalEvent::Haptics, payload);
+}
+
+void JournalRecorder::RecordPaint(int x, int y, MaterialType type, int soak) {
+    if (!m_file) return;
+    std::vector<uint8_t> payload;
+    Put(payload, static_cast<int32_t>(x));
+    Put(payload, static_cast<int32_t>(y));
+    Put(payload, static_cast<uint8_t>(type));
+    Put(payload, static_cast<uint8_t>(soak));
+    WriteEvent(JournalEvent::Paint, payload);
+}
+
+void JournalRecorder::RecordStroke(const glm::vec2& from, const glm::vec2& to, float radius, MaterialType type, int soak) {
+    if (!m_file) return;
+    std::vector<uint8_t> payload;
+    Put(payload, from.x);
+    Put(payload, from.y);
+    Put(payload, to.x);
+    Put(payload, to.y);
+    Put(payload, radius);
+    Put(payload, static_cast<uint8_t>(type));
+    Put(payload, static_cast<uint8_t>(soak));
+    WriteEvent(JournalEvent::Stroke, payload);
+}
+
+void JournalRecorder::RecordClear() {
+    if (m_file) std::fputc(static_cast<int>(JournalEvent::Clear), m_file);
+}
+
+void JournalRecorder::RecordRecenter(const glm::vec2& center) {
+    if (!m_file) return;
+    std::vector<uint8_t> payload;
+    Put(payload, center.x);
+    Put(payload, center.y);
+    WriteEvent(JournalEvent::Recenter, payload);
+}
+
+void JournalRecorder::RecordSettings(const SimSettings& settings) {
+    if (!m_file) return;
+    std::vector<uint8_t> payload = EncodeSettings(settings);
+    if (payload == m_lastSettings) return;
+    WriteEvent(JournalEvent::Settings, payload);
+    m_lastSettings = std::move(payload);
+}
+
+void JournalRecorder::RecordLoad(const SandSimulation& sim, const HapticSystem& haptics) {
+    if (!m_file) return;
+    // The loaded file may later be overwritten or moved, so the journal keeps its own copy
+    // of the world it produced; without one the rest of the session cannot be replayed
+    uint32_t load = m_loadCount + 1;
+    if (!SaveSnapshot(LoadedSnapshotPath(m_path, load), sim, &haptics)) {
+        std::cerr << "[Error] JournalRecorder: cannot keep snapshot load " << load << ", recording stopped" << std::endl;
+        Stop();
+        return;
+    }
+    m_loadCount = load;
+    std::vector<uint8_t> payload;
+    Put(payload, load);
+    WriteEvent(JournalEvent::Load, payload);
+}
+
+void JournalRecorder::RecordRegion(const DirtyRect& region) {
+    if (!m_file) return;
+    std::vector<uint8_t> payload;
+    Put(payload, static_cast<int32_t>(region.minX));
+    Put(payload, static_cast<int32_t>(region.minY));
+    Put(payload, static_cast<int32_t>(region.maxX));
+    Put(payload, static_cast<int32_t>(region.maxY));
+    WriteEvent(JournalEvent::Region, payload);
+}
+
+void JournalRecorder::RecordRegionTick() {
+    if (m_file) std::fputc(static_cast<int>(JournalEvent::RegionTick), m_file);
+}
+
+// --- Replay ---
+
+bool ReplayJournal(const std::string& path, SandSimulation& sim, HapticSystem& haptics, JournalReplayStats* stats,
+                   const JournalReplayHooks* hooks) {
+    MappedRegion region;
+    if (!region.MapFileCopy(path)) return false;
+
+    const auto* data = static_cast<const uint8_t*>(region.Data());
+    uint32_t version = 0;
+    if (region.Bytes() >= JOURNAL_HEADER_BYTES) std::memcpy(&version, data + sizeof(JOURNAL_MAGIC), sizeof(version));
+    if (region.Bytes() < JOURNAL_HEADER_BYTES || std::memcmp(data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+        version != JOURNAL_VERSION) {
+        std::cerr << "[Error] ReplayJournal: " << path << " is not a version " << JOURNAL_VERSION << " journal" << std::endl;
+        return false;
+    }
+
+    if (!LoadSnapshot(path + ".snap", sim, &haptics)) return false;
+
+    JournalReplayStats local;
+    JournalReplayStats& out = stats ? *stats : local;
+    out = JournalReplayStats{};
+
+    // Scheduler settings are recorded but have no effect on a back-to-back replay
+    SimScheduler scheduler;
+    const bool adjusting = hooks && hooks->adjustSettings;
+    // Snapshots bring their own tool configuration, which the hook gets to override
+    auto adjustLoaded = [&] {
+        if (!adjusting) return;
+        SimSettings settings = SimSettings::Capture(sim, haptics, scheduler);
+        hooks->adjustSettings(settings);
+        settings.ApplyTo(sim, haptics, scheduler);
+    };
+    adjustLoaded();
+    ByteReader in(data + JOURNAL_HEADER_BYTES, region.Bytes() - JOURNAL_HEADER_BYTES);
+    Clock::time_point replayStart = Clock::now();
+
+    bool ok = true;
+    while (ok && !in.Empty()) {
+        uint8_t event = 0;
+        in.Get(event);
+
+        switch (static_cast<JournalEvent>(event)) {
+            case JournalEvent::Tick: {
+                Clock::time_point start = Clock::now();
+                sim.Update();
+                out.updateMs += ElapsedMs(start);
+                ++out.ticks;
+                break;
+            }
+            case JournalEvent::Haptics: {
+                glm::vec2 mousePos;
+                float rawInputMeters;
+                uint8_t isMouseInput;
+                ok = in.Get(mousePos.x) && in.Get(mousePos.y) && in.Get(rawInputMeters) && in.Get(isMouseInput);
+                if (!ok) break;
+
+                Clock::time_point start = Clock::now();
+                haptics.Update(mousePos, rawInputMeters, isMouseInput != 0, sim);
+                out.hapticsMs += ElapsedMs(start);
+                ++out.hapticUpdates;
+                if (hooks && hooks->onHaptics) hooks->onHaptics(haptics);
+                break;
+            }
+            case JournalEvent::Paint: {
+                int32_t x, y;
+                uint8_t type, soak;
+                ok = in.Get(x) && in.Get(y) && in.Get(type) && in.Get(soak) &&
+                     type < static_cast<uint8_t>(MaterialType::Count) && soak <= SOAK_THRESHOLD;
+                if (ok) sim.Set(x, y, static_cast<MaterialType>(type), soak);
+                ++out.edits;
+                break;
+            }
+            case JournalEvent::Stroke: {
+                glm::vec2 from, to;
+                float radius;
+                uint8_t type, soak;
+                ok = in.Get(from.x) && in.Get(from.y) && in.Get(to.x) && in.Get(to.y) && in.Get(radius) &&
+                     in.Get(type) && in.Get(soak) && type < static_cast<uint8_t>(MaterialType::Count) &&
+                     soak <= SOAK_THRESHOLD;
+                if (ok) sim.FillLine(from, to, radius, static_cast<MaterialType>(type), soak);
+                ++out.edits;
+                break;
+            }
+            case JournalEvent::Clear:
+                sim.Clear();
+                ++out.edits;
+                break;
+            case JournalEvent::Recenter: {
+                glm::vec2 center;
+                ok = in.Get(center.x) && in.Get(center.y);
+                if (ok) haptics.Recenter(center);
+                ++out.edits;
+                break;
+            }
+            case JournalEvent::Settings: {
+                SimSettings settings;
+                ok = DecodeSettings(in, settings);
+                if (ok && adjusting) hooks->adjustSettings(settings);
+                if (ok) settings.ApplyTo(sim, haptics, scheduler);
+                ++out.edits;
+                break;
+            }
+            case JournalEvent::Load: {
+                uint32_t load = 0;
+                ok = in.Get(load) && LoadSnapshot(LoadedSnapshotPath(path, load), sim, &haptics);
+                if (ok) adjustLoaded();
+                ++out.edits;
+                break;
+            }
+            case JournalEvent::Region: {
+                int32_t minX, minY, maxX, maxY;
+                ok = in.Get(minX) && in.Get(minY) && in.Get(maxX) && in.Get(maxY);
+                if (ok) sim.SetRegion(DirtyRect{ minX, minY, maxX, maxY });
+                break;
+            }
+            case JournalEvent::RegionTick: {
+                Clock::time_point start = Clock::now();
+                sim.UpdateRegion();
+                out.updateMs += ElapsedMs(start);
+                ++out.regionTicks;
+                break;
+            }
+            default:
+                ok = false;
+                break;
+        }
+    }
+
+    out.totalMs = ElapsedMs(replayStart);
+    if (!ok) std::cerr << "[Error] ReplayJournal: " << path << " is truncated or corrupt" << std::endl;
+    return ok;
+}
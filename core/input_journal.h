@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "core/cell.h"
+#include "core/sand_simulation.h"
+#include "core/sim_settings.h"
+
+class HapticSystem;
+
+// --- Input Journal ---
+// Records everything that drives a session in the order the simulation thread applied
+// it: ticks, haptic updates (mouse grid position or device position), paints, brush
+// strokes, clears, recenters, snapshot loads, settings changes, and high-rate region
+// moves and sub-ticks. The world at the start is saved next to the journal as
+// <path>.snap, and the world after the n-th snapshot load as <path>.n.snap, so a replay
+// needs nothing but those files. The simulation and its random draws are deterministic,
+// so a replay reproduces the session exactly, headless and at full speed.
+
+enum class JournalEvent : uint8_t {
+    Tick,
+    Haptics,
+    Paint,
+    Clear,
+    Recenter,
+    Settings,
+    Load,
+    Region,
+    RegionTick,
+    Stroke,
+    Count
+};
+
+class JournalRecorder {
+private:
+    FILE* m_file = nullptr;
+    std::string m_path;
+    uint32_t m_loadCount = 0;
+    // Encoded form of the last recorded settings; unchanged settings are not repeated
+    std::vector<uint8_t> m_lastSettings;
+
+    void WriteEvent(JournalEvent event, const std::vector<uint8_t>& payload);
+
+public:
+    JournalRecorder() = default;
+    ~JournalRecorder();
+
+    JournalRecorder(const JournalRecorder&) = delete;
+    JournalRecorder& operator=(const JournalRecorder&) = delete;
+
+    bool Start(const std::string& path, const SandSimulation& sim, const HapticSystem& haptics, const SimSettings& settings);
+    void Stop();
+    [[nodiscard]] bool IsRecording() const { return m_file != nullptr; }
+
+    void RecordTick();
+    void RecordHaptics(const glm::vec2& mousePos, float rawInputMeters, bool isMouseInput);
+    void RecordPaint(int x, int y, MaterialType type, int soak);
+    void RecordStroke(const glm::vec2& from, const glm::vec2& to, float radius, MaterialType type, int soak);
+    void RecordClear();
+    void RecordRecenter(const glm::vec2& center);
+    void RecordSettings(const SimSettings& settings);
+    // Saves the world just loaded next to the journal and records that copy
+    void RecordLoad(const SandSimulation& sim, const HapticSystem& haptics);
+    void RecordRegion(const DirtyRect& region);
+    void RecordRegionTick();
+};
+
+struct JournalReplayStats {
+    uint64_t ticks = 0;
+    uint64_t regionTicks = 0;  // Timed with the full ticks in updateMs
+    uint64_t hapticUpdates = 0;
+    uint64_t edits = 0;  // Paints, strokes, clears, recenters, loads and settings changes
+    double updateMs = 0.0;
+    double hapticsMs = 0.0;
+    double totalMs = 0.0;
+};
+
+// Optional hooks into a replay
+struct JournalReplayHooks {
+    // Edits the recorded settings before they are applied: at the start, on every settings
+    // change and after every snapshot load. Lets one trace be replayed with other tool
+    // parameters.
+    std::function<void(SimSettings&)> adjustSettings;
+    // Called after every haptic update
+    std::function<void(const HapticSystem&)> onHaptics;
+};
+
+// Restores the starting world into sim and haptics, then applies every event back to back
+bool ReplayJournal(const std::string& path, SandSimulation& sim, HapticSystem& haptics,
+                   JournalReplayStats* stats = nullptr, const JournalReplayHooks* hooks = nullptr);
@@ -0,0 +1,187 @@
+#include "core/mapped_region.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Shrinks [offset, offset + bytes) to the whole pages it contains
+bool InnerPages(size_t offset, size_t bytes, size_t& first, size_t& length) {
+    size_t page = MappedRegion::PageSize();
+    first = (offset + page - 1) / page * page;
+    size_t end = (offset + bytes) / page * page;
+    if (end <= first) return false;
+    length = end - first;
+    return true;
+}
+
+}
+
+MappedRegion::~MappedRegion() { Unmap(); }
+
+MappedRegion::MappedRegion(MappedRegion&& other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)),
+      m_bytes(std::exchange(other.m_bytes, 0)),
+      m_fd(std::exchange(other.m_fd, -1)),
+      m_privateFile(std::exchange(other.m_privateFile, false)) {}
+
+MappedRegion& MappedRegion::operator=(MappedRegion&& other) noexcept {
+    if (this != &other) {
+        Unmap();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_bytes = std::exchange(other.m_bytes, 0);
+        m_fd = std::exchange(other.m_fd, -1);
+        m_privateFile = std::exchange(other.m_privateFile, false);
+    }
+    return *this;
+}
+
+size_t MappedRegion::PageSize() {
+    static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return pageSize;
+}
+
+bool MappedRegion::MapFile(const std::string& path, size_t bytes) {
+    Unmap();
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        std::cerr << "[Error] MapFile: cannot open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || (info.st_size == 0 && ftruncate(fd, static_cast<off_t>(bytes)) != 0)) {
+        std::cerr << "[Error] MapFile: cannot size " << path << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    if (info.st_size != 0 && static_cast<size_t>(info.st_size) < bytes) {
+        std::cerr << "[Error] MapFile: " << path << " is smaller than expected" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "[Error] MapFile: cannot map " << path << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    m_data = data;
+    m_bytes = bytes;
+    m_fd = fd;
+    return true;
+}
+
+bool MappedRegion::MapFileCopy(const std::string& path) {
+    Unmap();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "[Error] MapFileCopy: cannot open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "[Error] MapFileCopy: " << path << " is empty or unreadable" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    size_t bytes = static_cast<size_t>(info.st_size);
+    void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "[Error] MapFileCopy: cannot map " << path << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    // A private mapping needs no descriptor and never writes back
+    close(fd);
+    m_data = data;
+    m_bytes = bytes;
+    m_privateFile = true;
+    return true;
+}
+
+bool MappedRegion::MapAnonymous(size_t bytes) {
+    Unmap();
+
+    void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "[Error] MapAnonymous: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    m_data = data;
+    m_bytes = bytes;
+    return true;
+}
+
+void MappedRegion::Unmap() {
+    if (m_data) {
+        if (m_fd >= 0) msync(m_data, m_bytes, MS_SYNC);
+        munmap(m_data, m_bytes);
+        m_data = nullptr;
+        m_bytes = 0;
+        m_privateFile = false;
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void MappedRegion::Sync() {
+    if (m_data && m_fd >= 0) msync(m_data, m_bytes, MS_SYNC);
+}
+
+void MappedRegion::Release(size_t offset, size_t bytes) {
+    size_t first = 0, length = 0;
+    if (!m_data || m_privateFile || !InnerPages(offset, bytes, first, length)) return;
+
+    char* start = static_cast<char*>(m_data) + first;
+    if (m_fd >= 0) {
+        // Clean pages can be reclaimed right away; dirty ones start writing back and are
+        // left to the page cache once unmapped
+#ifdef MADV_PAGEOUT
+        madvise(start, length, MADV_PAGEOUT);
+#endif
+        msync(start, length, MS_ASYNC);
+    }
+    madvise(start, length, MADV_DONTNEED);
+}
+
+void MappedRegion::Zero(size_t offset, size_t bytes) {
+    if (!m_data) return;
+
+    char* base = static_cast<char*>(m_data);
+    size_t first = 0, length = 0;
+    if (!InnerPages(offset, bytes, first, length)) {
+        std::memset(base + offset, 0, bytes);
+        return;
+    }
+
+    bool zeroed = false;
+    if (m_fd >= 0) {
+        zeroed = fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(first),
+                           static_cast<off_t>(length)) == 0;
+    } else if (!m_privateFile) {
+        zeroed = madvise(base + first, length, MADV_DONTNEED) == 0;
+    }
+    if (!zeroed) std::memset(base + first, 0, length);
+
+    // Partial pages at either end
+    std::memset(base + offset, 0, first - offset);
+    std::memset(base + first + length, 0, offset + bytes - (first + length));
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// --- Mapped Region ---
+// One mmap'd byte range, either a shared mapping of a file, so the kernel pages it in
+// and out of that file on demand, or lazily zeroed anonymous memory. Pages are only
+// backed once touched, so mapping a huge range is O(1).
+class MappedRegion {
+private:
+    void* m_data = nullptr;
+    size_t m_bytes = 0;
+    int m_fd = -1;             // Shared file mappings only
+    bool m_privateFile = false;
+
+public:
+    MappedRegion() = default;
+    ~MappedRegion();
+
+    MappedRegion(MappedRegion&& other) noexcept;
+    MappedRegion& operator=(MappedRegion&& other) noexcept;
+    MappedRegion(const MappedRegion&) = delete;
+    MappedRegion& operator=(const MappedRegion&) = delete;
+
+    [[nodiscard]] static size_t PageSize();
+
+    // Creates the file, zero-filled, if it is missing or empty; an existing file must
+    // already hold at least `bytes`
+    bool MapFile(const std::string& path, size_t bytes);
+    // Private copy-on-write view of a whole existing file: pages load lazily and writes
+    // never reach the file
+    bool MapFileCopy(const std::string& path);
+    bool MapAnonymous(size_t bytes);
+    void Unmap();
+
+    [[nodiscard]] void* Data() const { return m_data; }
+    [[nodiscard]] size_t Bytes() const { return m_bytes; }
+    [[nodiscard]] bool IsMapped() const { return m_data != nullptr; }
+
+    // Writes dirty file pages back
+    void Sync();
+    // Drops the whole pages inside [offset, offset + bytes) from the process. Shared file
+    // pages are written back and fault in again on the next access; anonymous pages come
+    // back zeroed. Private file copies keep their pages, since dropping them would undo
+    // any writes.
+    void Release(size_t offset, size_t bytes);
+    // Zeroes [offset, offset + bytes) without touching pages that are not resident
+    void Zero(size_t offset, size_t bytes);
+};
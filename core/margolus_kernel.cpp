@@ -0,0 +1,114 @@
+#include "core/margolus_kernel.h"
+
+#include <array>
+#include <utility>
+
+#include "core/material.h"
+
+namespace margolus {
+
+namespace {
+
+constexpr auto SINK_MASKS = [] {
+    std::array<uint32_t, static_cast<size_t>(MaterialType::Count)> masks{};
+    for (size_t i = 0; i < masks.size(); ++i) masks[i] = GetSinkMask(static_cast<MaterialType>(i));
+    return masks;
+}();
+
+// Block-mates a wetting liquid reaches, nearest first: below, beside, above, diagonal
+constexpr int WET_TARGETS[4][3] = {
+    { BOTTOM_LEFT, TOP_RIGHT, BOTTOM_RIGHT },
+    { BOTTOM_RIGHT, TOP_LEFT, BOTTOM_LEFT },
+    { BOTTOM_RIGHT, TOP_LEFT, TOP_RIGHT },
+    { BOTTOM_LEFT, TOP_RIGHT, TOP_LEFT },
+};
+
+bool IsWall(const Block& block, int i) {
+    return (block.walls >> i) & 1;
+}
+
+// On the grid's bottom row, whichever row of the block that falls on
+bool IsGrounded(const Block& block, int i) {
+    return i >= BOTTOM_LEFT ? block.onFloor : IsWall(block, i + 2);
+}
+
+bool IsEmpty(const Block& block, int i) {
+    return !IsWall(block, i) && block.cells[i].type == MaterialType::Empty;
+}
+
+Mobility GetMobility(const Block& block, int i) {
+    return IsWall(block, i) ? Mobility::Static : GetMaterial(block.cells[i].type).mobility;
+}
+
+// Liquids soak into absorbent block-mates and are used up, bottom cells first
+bool Wet(Block& block) {
+    bool wetted = false;
+    for (int i : { BOTTOM_LEFT, BOTTOM_RIGHT, TOP_LEFT, TOP_RIGHT }) {
+        if (IsWall(block, i) || !GetMaterial(block.cells[i].type).wets) continue;
+
+        for (int j : WET_TARGETS[i]) {
+            if (IsWall(block, j)) continue;
+            Cell& target = block.cells[j];
+            const MaterialDesc& desc = GetMaterial(target.type);
+            if (desc.wetForm == MaterialType::Empty || target.soak >= desc.maxSoak) continue;
+
+            target = { desc.wetForm, target.soak + 1 };
+            block.cells[i] = {};
+            wetted = true;
+            break;
+        }
+    }
+    return wetted;
+}
+
+// Falls into an empty cell or sinks through a lighter liquid
+bool CanFall(const Block& block, int top, int bottom) {
+    if (IsWall(block, bottom) || GetMobility(block, top) == Mobility::Static) return false;
+    MaterialType below = block.cells[bottom].type;
+    return below == MaterialType::Empty || ((SINK_MASKS[static_cast<int>(block.cells[top].type)] >> static_cast<int>(below)) & 1);
+}
+
+}
+
+bool UpdateBlock(Block& block, bool lateralFlow) {
+    if (Wet(block)) return true;
+
+    // Columns fall independently
+    bool fell = false;
+    for (int top : { TOP_LEFT, TOP_RIGHT }) {
+        if (CanFall(block, top, top + 2)) {
+            std::swap(block.cells[top], block.cells[top + 2]);
+            fell = true;
+        }
+    }
+    if (fell) return true;
+
+    // A top cell resting on something slides into an empty cell diagonally below. Both
+    // top cells cannot qualify at once: each needs the other's column blocked below.
+    for (int top : { TOP_LEFT, TOP_RIGHT }) {
+        Mobility mobility = GetMobility(block, top);
+        int diagonal = BOTTOM_RIGHT - top;
+        if ((mobility == Mobility::Powder || mobility == Mobility::Liquid) && IsEmpty(block, diagonal)) {
+            std::swap(block.cells[top], block.cells[diagonal]);
+            return true;
+        }
+    }
+    if (!lateralFlow) return false;
+
+    // Liquids flow sideways into an empty neighbour, bottom row first. Alternating block
+    // offsets carry the flow on across block boundaries, so a cell with room on both
+    // sides keeps going; on the grid's bottom row it settles instead, letting its chunk
+    // sleep.
+    for (int left : { BOTTOM_LEFT, TOP_LEFT }) {
+        int right = left + 1;
+        if (IsGrounded(block, left)) continue;
+        if ((GetMobility(block, left) == Mobility::Liquid && IsEmpty(block, right)) ||
+            (GetMobility(block, right) == Mobility::Liquid && IsEmpty(block, left))) {
+            std::swap(block.cells[left], block.cells[right]);
+            return true;
+        }
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include "core/cell.h"
+
+// --- Margolus Kernel ---
+// 2x2 block rules for the Margolus engine. Blocks tile the grid on an offset that
+// alternates every tick, and a block's next state depends on its own four cells only,
+// so blocks can update in any order or concurrently.
+namespace margolus {
+
+// Cell order within a block
+constexpr int TOP_LEFT = 0;
+constexpr int TOP_RIGHT = 1;
+constexpr int BOTTOM_LEFT = 2;
+constexpr int BOTTOM_RIGHT = 3;
+
+// Cells outside the grid are walls: solid, never moved and never soaked. Liquid on the
+// grid's bottom row stays put, as it does under the scan rules.
+struct Block {
+    Cell cells[4];
+    uint8_t walls = 0;      // Bit per cell
+    bool onFloor = false;  // The bottom row is the grid's bottom row
+};
+
+// Applies one tick of rules, returning whether any cell changed. The rules are
+// deterministic, so a block that does not change stays put until a neighbour does.
+// Liquids only flow sideways when `lateralFlow` is set; hydrostatic leveling does it
+// in bulk otherwise.
+bool UpdateBlock(Block& block, bool lateralFlow);
+
+}
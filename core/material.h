@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "core/cell.h"
+
+// --- Materials ---
+// One descriptor per MaterialType. Update kernels, haptic resistance, wetting and the
+// renderer's colours all read this table; kernels are specialized on it at compile time,
+// so a new material costs the existing ones nothing.
+
+// How a material moves on its own
+enum class Mobility : uint8_t {
+    Static,   // Never moves
+    Clump,    // Falls straight down
+    Powder,   // Falls straight down or diagonally
+    Liquid,   // Falls straight down or diagonally, then spreads sideways
+};
+
+struct MaterialColor {
+    uint8_t r, g, b, a;
+};
+
+struct MaterialDesc {
+    Mobility mobility;
+    int density;                  // Cells sink by swapping with lighter liquids below them
+    float resistance;             // Haptic drag per covered cell
+    float soakResistance;         // Extra drag per soak level
+    MaterialColor color;
+    MaterialColor saturatedColor; // Once soak reaches SOAK_THRESHOLD
+    bool wets;                    // Liquid soaks into absorbent neighbours and is used up
+    MaterialType wetForm;         // Absorbent materials turn into this, Empty otherwise
+    int maxSoak;                  // Absorbent materials take liquid while below this soak
+};
+
+inline constexpr MaterialDesc MATERIALS[] = {
+    // Empty
+    { Mobility::Static, 0, 0.0f, 0.0f, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, false, MaterialType::Empty, 0 },
+    // Sand
+    { Mobility::Powder, 2, 0.1f, 0.0f, { 235, 200, 100, 255 }, { 235, 200, 100, 255 }, false, MaterialType::WetSand,
+      SOAK_THRESHOLD },
+    // WetSand
+    { Mobility::Clump, 3, 0.1f, 0.02f, { 160, 130, 70, 255 }, { 100, 80, 40, 255 }, false, MaterialType::WetSand,
+      SOAK_THRESHOLD },
+    // Water
+    { Mobility::Liquid, 1, 0.02f, 0.0f, { 0, 120, 255, 200 }, { 0, 120, 255, 200 }, true, MaterialType::Empty, 0 },
+};
+static_assert(sizeof(MATERIALS) / sizeof(MATERIALS[0]) == static_cast<size_t>(MaterialType::Count),
+              "every material needs a descriptor");
+
+// Cells a wetting liquid reaches: the 8 neighbours, then two rows down
+inline constexpr int WET_OFFSETS[9][2] = {{0, 1}, {1, 0}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {1, -1}, {-1, -1}, {0, 2}};
+
+constexpr const MaterialDesc& GetMaterial(MaterialType type) {
+    return MATERIALS[static_cast<int>(type)];
+}
+
+// Bit per material that `type` sinks through: lighter liquids
+constexpr uint32_t GetSinkMask(MaterialType type) {
+    uint32_t mask = 0;
+    for (int i = 0; i < static_cast<int>(MaterialType::Count); ++i) {
+        if (MATERIALS[i].mobility == Mobility::Liquid && MATERIALS[i].density < GetMaterial(type).density) {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+inline float GetCellResistance(const Cell& cell) {
+    const MaterialDesc& desc = GetMaterial(cell.type);
+    return desc.resistance + cell.soak * desc.soakResistance;
+}
+
+inline MaterialColor GetCellColor(const Cell& cell) {
+    const MaterialDesc& desc = GetMaterial(cell.type);
+    return cell.soak >= SOAK_THRESHOLD ? desc.saturatedColor : desc.color;
+}
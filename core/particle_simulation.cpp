@@ -0,0 +1,489 @@
+#include "core/particle_simulation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "core/material.h"
+#include "core/worker_pool.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SANDSIM_PARTICLE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Grains per parallel work item; small enough to balance, large enough to amortize
+constexpr size_t GRAINS_PER_ITEM = 2048;
+
+// Tangential damping relative to normal; stiffer shear lets resting grains hold a slope
+// instead of creeping flat
+constexpr float SHEAR_DAMPING_SCALE = 4.0f;
+
+// Random stream for the scatter of newly seeded grains
+constexpr uint64_t SCATTER_STREAM = 2;
+
+struct ContactParams {
+    float diameter;
+    float stiffness;
+    float damping;
+    float shearDamping;
+};
+
+struct GrainView {
+    const float* posX;
+    const float* posY;
+    const float* velX;
+    const float* velY;
+    const float* friction;
+};
+
+// Spring-dashpot normal force plus viscous tangential force capped by Coulomb friction.
+// The normal points from the partner to the grain and the tangent is it turned 90 degrees.
+inline void AddContact(float nx, float ny, float penetration, float dvx, float dvy, float mu,
+                       const ContactParams& params, float& fx, float& fy) {
+    float vn = dvx * nx + dvy * ny;
+    float fn = std::max(params.stiffness * penetration - params.damping * vn, 0.0f);
+    float vt = dvy * nx - dvx * ny;
+    float limit = mu * fn;
+    float ft = std::clamp(-params.shearDamping * vt, -limit, limit);
+    fx += fn * nx - ft * ny;
+    fy += fn * ny + ft * nx;
+}
+
+// A contiguous range of grains, e.g. three neighbouring bins of one bin row
+struct Run {
+    size_t first;
+    size_t last;
+};
+
+void AccumulateScalar(const GrainView& g, size_t i, size_t first, size_t last, const ContactParams& params,
+                      float& fx, float& fy) {
+    const float d2Max = params.diameter * params.diameter;
+    for (size_t j = first; j < last; ++j) {
+        float dx = g.posX[i] - g.posX[j];
+        float dy = g.posY[i] - g.posY[j];
+        float d2 = dx * dx + dy * dy;
+        if (d2 >= d2Max || d2 <= 1e-12f) continue;
+
+        float dist = std::sqrt(d2);
+        AddContact(dx / dist, dy / dist, params.diameter - dist, g.velX[i] - g.velX[j], g.velY[i] - g.velY[j],
+                   std::min(g.friction[i], g.friction[j]), params, fx, fy);
+    }
+}
+
+#if SANDSIM_PARTICLE_X86
+// Eight partners per step, with contacts masked in rather than branched on. A run's
+// last step reads past its end and masks those lanes off, unless that would read past
+// the arrays; only then does the scalar loop take the remainder.
+__attribute__((target("avx2")))
+void AccumulateAvx2(const GrainView& g, size_t count, size_t i, const Run* runs, int runCount,
+                    const ContactParams& params, float& fx, float& fy) {
+    const __m256 xi = _mm256_set1_ps(g.posX[i]);
+    const __m256 yi = _mm256_set1_ps(g.posY[i]);
+    const __m256 vxi = _mm256_set1_ps(g.velX[i]);
+    const __m256 vyi = _mm256_set1_ps(g.velY[i]);
+    const __m256 mui = _mm256_set1_ps(g.friction[i]);
+    const __m256 diameter = _mm256_set1_ps(params.diameter);
+    const __m256 d2Max = _mm256_set1_ps(params.diameter * params.diameter);
+    const __m256 d2Min = _mm256_set1_ps(1e-12f);
+    const __m256 stiffness = _mm256_set1_ps(params.stiffness);
+    const __m256 damping = _mm256_set1_ps(params.damping);
+    const __m256 shearDamping = _mm256_set1_ps(params.shearDamping);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    __m256 sumX = zero;
+    __m256 sumY = zero;
+    for (int r = 0; r < runCount; ++r) {
+        size_t j = runs[r].first;
+        const size_t last = runs[r].last;
+        for (; j < last && j + 8 <= count; j += 8) {
+            __m256i remaining = _mm256_set1_epi32(static_cast<int>(std::min<size_t>(last - j, 8)));
+            __m256 inRun = _mm256_castsi256_ps(_mm256_cmpgt_epi32(remaining, lanes));
+
+            __m256 dx = _mm256_sub_ps(xi, _mm256_loadu_ps(g.posX + j));
+            __m256 dy = _mm256_sub_ps(yi, _mm256_loadu_ps(g.posY + j));
+            __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            __m256 contact = _mm256_and_ps(_mm256_cmp_ps(d2, d2Max, _CMP_LT_OQ), _mm256_cmp_ps(d2, d2Min, _CMP_GT_OQ));
+            contact = _mm256_and_ps(contact, inRun);
+            if (_mm256_movemask_ps(contact) == 0) continue;
+
+            __m256 dist = _mm256_sqrt_ps(_mm256_max_ps(d2, d2Min));
+            __m256 nx = _mm256_div_ps(dx, dist);
+            __m256 ny = _mm256_div_ps(dy, dist);
+            __m256 penetration = _mm256_sub_ps(diameter, dist);
+            __m256 dvx = _mm256_sub_ps(vxi, _mm256_loadu_ps(g.velX + j));
+            __m256 dvy = _mm256_sub_ps(vyi, _mm256_loadu_ps(g.velY + j));
+
+            __m256 vn = _mm256_add_ps(_mm256_mul_ps(dvx, nx), _mm256_mul_ps(dvy, ny));
+            __m256 fn = _mm256_max_ps(_mm256_sub_ps(_mm256_mul_ps(stiffness, penetration), _mm256_mul_ps(damping, vn)), zero);
+            __m256 vt = _mm256_sub_ps(_mm256_mul_ps(dvy, nx), _mm256_mul_ps(dvx, ny));
+            __m256 limit = _mm256_mul_ps(_mm256_min_ps(mui, _mm256_loadu_ps(g.friction + j)), fn);
+            __m256 ft = _mm256_sub_ps(zero, _mm256_mul_ps(shearDamping, vt));
+            ft = _mm256_max_ps(_mm256_min_ps(ft, limit), _mm256_sub_ps(zero, limit));
+
+            __m256 cx = _mm256_sub_ps(_mm256_mul_ps(fn, nx), _mm256_mul_ps(ft, ny));
+            __m256 cy = _mm256_add_ps(_mm256_mul_ps(fn, ny), _mm256_mul_ps(ft, nx));
+            sumX = _mm256_add_ps(sumX, _mm256_and_ps(cx, contact));
+            sumY = _mm256_add_ps(sumY, _mm256_and_ps(cy, contact));
+        }
+        if (j < last) AccumulateScalar(g, i, j, last, params, fx, fy);
+    }
+
+    alignas(32) float lanesX[8];
+    alignas(32) float lanesY[8];
+    _mm256_store_ps(lanesX, sumX);
+    _mm256_store_ps(lanesY, sumY);
+    for (int lane = 0; lane < 8; ++lane) {
+        fx += lanesX[lane];
+        fy += lanesY[lane];
+    }
+}
+
+bool HasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+void Accumulate(const GrainView& g, size_t count, size_t i, const Run* runs, int runCount,
+                const ContactParams& params, float& fx, float& fy) {
+#if SANDSIM_PARTICLE_X86
+    if (HasAvx2()) {
+        AccumulateAvx2(g, count, i, runs, runCount, params, fx, fy);
+        return;
+    }
+#endif
+    for (int r = 0; r < runCount; ++r) AccumulateScalar(g, i, runs[r].first, runs[r].last, params, fx, fy);
+}
+
+float GetGrainFriction(MaterialType type, float friction) {
+    switch (GetMaterial(type).mobility) {
+        case Mobility::Liquid: return 0.0f;
+        case Mobility::Clump:  return 2.0f * friction;
+        default:               return friction;
+    }
+}
+
+template <typename T>
+void Permute(std::vector<T>& values, const std::vector<uint32_t>& order, std::vector<T>& scratch) {
+    scratch.resize(values.size());
+    for (size_t i = 0; i < order.size(); ++i) scratch[i] = values[order[i]];
+    values.swap(scratch);
+}
+
+}
+
+ParticleSimulation::ParticleSimulation() {
+    ResizeBins();
+}
+
+ParticleSimulation::~ParticleSimulation() = default;
+
+void ParticleSimulation::Resize(int w, int h) {
+    width = w;
+    height = h;
+    Clear();
+}
+
+void ParticleSimulation::Clear() {
+    for (std::vector<float>* values : { &m_posX, &m_posY, &m_velX, &m_velY, &m_forceX, &m_forceY, &m_friction }) {
+        values->clear();
+    }
+    m_types.clear();
+    m_soaks.clear();
+    ResizeBins();
+}
+
+void ParticleSimulation::ResizeBins() {
+    m_binWidth = 2.0f * grainDiameter;
+    m_binHeight = grainDiameter;
+    m_binsX = std::max(1, static_cast<int>(std::ceil(width / m_binWidth)));
+    m_binsY = std::max(1, static_cast<int>(std::ceil(height / m_binHeight)));
+    m_binStart.assign(static_cast<size_t>(m_binsX) * m_binsY + 1, 0);
+    SortIntoBins();
+}
+
+void ParticleSimulation::SortIntoBins() {
+    // Counting sort, stable, so grains keep their relative order within a bin
+    const size_t count = m_posX.size();
+    m_binOf.resize(count);
+    std::fill(m_binStart.begin(), m_binStart.end(), 0);
+    for (size_t i = 0; i < count; ++i) {
+        int bx = std::clamp(static_cast<int>(m_posX[i] / m_binWidth), 0, m_binsX - 1);
+        int by = std::clamp(static_cast<int>(m_posY[i] / m_binHeight), 0, m_binsY - 1);
+        m_binOf[i] = static_cast<uint32_t>(by * m_binsX + bx);
+        ++m_binStart[m_binOf[i] + 1];
+    }
+    for (size_t b = 1; b < m_binStart.size(); ++b) m_binStart[b] += m_binStart[b - 1];
+
+    m_order.resize(count);
+    std::vector<uint32_t> cursor(m_binStart.begin(), m_binStart.end() - 1);
+    for (size_t i = 0; i < count; ++i) m_order[cursor[m_binOf[i]]++] = static_cast<uint32_t>(i);
+
+    for (std::vector<float>* values : { &m_posX, &m_posY, &m_velX, &m_velY, &m_friction }) {
+        Permute(*values, m_order, m_scratch);
+    }
+    Permute(m_types, m_order, m_scratchBytes);
+    Permute(m_soaks, m_order, m_scratchBytes);
+    m_forceX.resize(count);
+    m_forceY.resize(count);
+}
+
+template <typename Fn>
+void ParticleSimulation::ForEachGrainRange(Fn&& fn) {
+    const size_t count = m_posX.size();
+    const int items = static_cast<int>((count + GRAINS_PER_ITEM - 1) / GRAINS_PER_ITEM);
+    if (threadCount <= 1 || items <= 1) {
+        fn(size_t{0}, count);
+        return;
+    }
+
+    if (!m_pool || m_pool->GetThreadCount() != threadCount) m_pool = std::make_unique<WorkerPool>(threadCount);
+    m_pool->ParallelFor(items, [&fn, count](int item, int) {
+        size_t first = static_cast<size_t>(item) * GRAINS_PER_ITEM;
+        fn(first, std::min(first + GRAINS_PER_ITEM, count));
+    });
+}
+
+template <typename Fn>
+void ParticleSimulation::ForEachGrainNear(float minX, float minY, float maxX, float maxY, Fn&& fn) const {
+    int bx0 = std::clamp(static_cast<int>(std::floor(minX / m_binWidth)) - 1, 0, m_binsX - 1);
+    int bx1 = std::clamp(static_cast<int>(std::floor(maxX / m_binWidth)) + 1, 0, m_binsX - 1);
+    int by0 = std::clamp(static_cast<int>(std::floor(minY / m_binHeight)) - 1, 0, m_binsY - 1);
+    int by1 = std::clamp(static_cast<int>(std::floor(maxY / m_binHeight)) + 1, 0, m_binsY - 1);
+
+    // Bins are one margin wider than the box, as grains drift between sorts
+    for (int by = by0; by <= by1; ++by) {
+        size_t first = m_binStart[by * m_binsX + bx0];
+        size_t last = m_binStart[by * m_binsX + bx1 + 1];
+        for (size_t i = first; i < last; ++i) fn(i);
+    }
+    for (size_t i = m_binStart.back(); i < m_posX.size(); ++i) fn(i);
+}
+
+void ParticleSimulation::ComputeForces(size_t first, size_t last) {
+    const GrainView grains = { m_posX.data(), m_posY.data(), m_velX.data(), m_velY.data(), m_friction.data() };
+    const ContactParams params = { grainDiameter, stiffness, damping, damping * SHEAR_DAMPING_SCALE };
+    const float r = grainDiameter * 0.5f;
+    const size_t count = m_posX.size();
+
+    for (size_t i = first; i < last; ++i) {
+        float x = m_posX[i];
+        float y = m_posY[i];
+        float fx = 0.0f;
+        float fy = gravity;
+
+        // A bin is two diameters wide, so partners lie in the grain's own bin and the one
+        // on the side of it the grain is nearer to; in each of the three bin rows those two
+        // bins are one contiguous run
+        float binX = x / m_binWidth;
+        int bx = std::clamp(static_cast<int>(binX), 0, m_binsX - 1);
+        int by = std::clamp(static_cast<int>(y / m_binHeight), 0, m_binsY - 1);
+        int bx0 = binX - bx < 0.5f ? std::max(bx - 1, 0) : bx;
+        int bx1 = std::min(bx0 + 1, m_binsX - 1);
+        Run runs[3];
+        int runCount = 0;
+        for (int row = std::max(by - 1, 0); row <= std::min(by + 1, m_binsY - 1); ++row) {
+            runs[runCount++] = { m_binStart[row * m_binsX + bx0], m_binStart[row * m_binsX + bx1 + 1] };
+        }
+        Accumulate(grains, count, i, runs, runCount, params, fx, fy);
+
+        // Walls are contacts with a fixed partner
+        float vx = m_velX[i];
+        float vy = m_velY[i];
+        float mu = m_friction[i];
+        if (x < r) AddContact(1.0f, 0.0f, r - x, vx, vy, mu, params, fx, fy);
+        if (x > width - r) AddContact(-1.0f, 0.0f, x - (width - r), vx, vy, mu, params, fx, fy);
+        if (y < r) AddContact(0.0f, 1.0f, r - y, vx, vy, mu, params, fx, fy);
+        if (y > height - r) AddContact(0.0f, -1.0f, y - (height - r), vx, vy, mu, params, fx, fy);
+
+        m_forceX[i] = fx;
+        m_forceY[i] = fy;
+    }
+}
+
+void ParticleSimulation::Integrate(size_t first, size_t last, float dt) {
+    // Semi-implicit Euler; static grains are anchored and only push back
+    for (size_t i = first; i < last; ++i) {
+        if (GetMaterial(static_cast<MaterialType>(m_types[i])).mobility == Mobility::Static) continue;
+        m_velX[i] += m_forceX[i] * dt;
+        m_velY[i] += m_forceY[i] * dt;
+        m_posX[i] = std::clamp(m_posX[i] + m_velX[i] * dt, 0.0f, static_cast<float>(width));
+        m_posY[i] = std::clamp(m_posY[i] + m_velY[i] * dt, 0.0f, static_cast<float>(height));
+    }
+}
+
+void ParticleSimulation::Step() {
+    const float dt = 1.0f / static_cast<float>(std::max(substeps, 1));
+    for (int s = 0; s < std::max(substeps, 1); ++s) {
+        SortIntoBins();
+        ForEachGrainRange([this](size_t first, size_t last) { ComputeForces(first, last); });
+        ForEachGrainRange([this, dt](size_t first, size_t last) { Integrate(first, last, dt); });
+    }
+    ++m_tickCount;
+}
+
+bool ParticleSimulation::AddGrain(float x, float y, MaterialType type, int soak) {
+    if (m_posX.size() >= maxGrains || type == MaterialType::Empty) return false;
+    m_posX.push_back(std::clamp(x, 0.0f, static_cast<float>(width)));
+    m_posY.push_back(std::clamp(y, 0.0f, static_cast<float>(height)));
+    m_velX.push_back(0.0f);
+    m_velY.push_back(0.0f);
+    m_forceX.push_back(0.0f);
+    m_forceY.push_back(0.0f);
+    m_friction.push_back(GetGrainFriction(type, friction));
+    m_types.push_back(static_cast<uint8_t>(type));
+    m_soaks.push_back(static_cast<uint8_t>(soak));
+    return true;
+}
+
+void ParticleSimulation::Paint(int x, int y, MaterialType type, int soak) {
+    if (x < 0 || y < 0 || x >= width || y >= height) return;
+
+    if (type == MaterialType::Empty) {
+        m_erase.assign(m_posX.size(), 0);
+        MarkGrainsInCell(x, y);
+        EraseMarkedGrains();
+        return;
+    }
+
+    bool occupied = false;
+    const float x0 = static_cast<float>(x);
+    const float y0 = static_cast<float>(y);
+    ForEachGrainNear(x0, y0, x0 + 1.0f, y0 + 1.0f, [&](size_t i) { occupied = occupied || IsGrainInCell(i, x, y); });
+    if (occupied) return;
+    AddCellGrains(x, y, type, soak);
+}
+
+void ParticleSimulation::AddCellGrains(int x, int y, MaterialType type, int soak) {
+    // A filled cell holds an n x n lattice of grains, scattered slightly
+    const float x0 = static_cast<float>(x);
+    const float y0 = static_cast<float>(y);
+    int n = std::max(1, static_cast<int>(std::lround(1.0f / grainDiameter)));
+    float spacing = 1.0f / static_cast<float>(n);
+    for (int gy = 0; gy < n; ++gy) {
+        for (int gx = 0; gx < n; ++gx) {
+            uint64_t bits = CounterRandom(seed, m_tickCount, x * n + gx, y * n + gy, SCATTER_STREAM);
+            float jitter = (static_cast<float>(bits & 0xFFFF) / 65535.0f - 0.5f) * 0.05f * spacing;
+            AddGrain(x0 + (gx + 0.5f) * spacing + jitter, y0 + (gy + 0.5f) * spacing, type, soak);
+        }
+    }
+}
+
+void ParticleSimulation::MarkGrainsInCell(int x, int y) {
+    const float x0 = static_cast<float>(x);
+    const float y0 = static_cast<float>(y);
+    ForEachGrainNear(x0, y0, x0 + 1.0f, y0 + 1.0f, [&](size_t i) {
+        if (m_erase[i] || !IsGrainInCell(i, x, y)) return;
+        m_erase[i] = 1;
+        ++m_eraseCount;
+    });
+}
+
+void ParticleSimulation::EraseMarkedGrains() {
+    // Compacting shifts the grains, so the bins are rebuilt straight after
+    if (m_eraseCount > 0) {
+        size_t kept = 0;
+        for (size_t i = 0; i < m_posX.size(); ++i) {
+            if (m_erase[i]) continue;
+            m_posX[kept] = m_posX[i];
+            m_posY[kept] = m_posY[i];
+            m_velX[kept] = m_velX[i];
+            m_velY[kept] = m_velY[i];
+            m_friction[kept] = m_friction[i];
+            m_types[kept] = m_types[i];
+            m_soaks[kept] = m_soaks[i];
+            ++kept;
+        }
+        for (std::vector<float>* values : { &m_posX, &m_posY, &m_velX, &m_velY, &m_friction }) values->resize(kept);
+        m_types.resize(kept);
+        m_soaks.resize(kept);
+        SortIntoBins();
+    }
+    m_erase.clear();
+    m_eraseCount = 0;
+}
+
+void ParticleSimulation::PaintStroke(const glm::vec2& from, const glm::vec2& to, float radius, MaterialType type, int soak) {
+    // Fills go cell by cell through Paint; erasing marks every covered cell's grains and
+    // compacts once
+    const bool erase = type == MaterialType::Empty;
+    if (erase) m_erase.assign(m_posX.size(), 0);
+    const glm::vec2 along = to - from;
+    const float lengthSq = glm::dot(along, along);
+    const float r2 = radius * radius;
+    const int x0 = std::max(static_cast<int>(std::ceil(std::min(from.x, to.x) - radius)), 0);
+    const int x1 = std::min(static_cast<int>(std::floor(std::max(from.x, to.x) + radius)), width - 1);
+    const int y0 = std::max(static_cast<int>(std::ceil(std::min(from.y, to.y) - radius)), 0);
+    const int y1 = std::min(static_cast<int>(std::floor(std::max(from.y, to.y) + radius)), height - 1);
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const glm::vec2 cell(static_cast<float>(x), static_cast<float>(y));
+            const float t = lengthSq > 0.0f ? std::clamp(glm::dot(cell - from, along) / lengthSq, 0.0f, 1.0f) : 0.0f;
+            const glm::vec2 offset = cell - (from + along * t);
+            if (glm::dot(offset, offset) > r2) continue;
+            if (erase) MarkGrainsInCell(x, y);
+            else Paint(x, y, type, soak);
+        }
+    }
+    if (erase) EraseMarkedGrains();
+}
+
+void ParticleSimulation::LoadCells(int w, int h, const std::vector<PackedCell>& cells) {
+    Resize(w, h);
+    // Every cell starts empty and is filled once, so Paint's occupancy check, which walks
+    // all grains added since the last sort, is skipped
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            Cell cell = UnpackCell(cells[static_cast<size_t>(y) * w + x]);
+            if (cell.type != MaterialType::Empty) AddCellGrains(x, y, cell.type, cell.soak);
+        }
+    }
+    SortIntoBins();
+}
+
+float ParticleSimulation::GetResistance(float cx, float cy, float radius) const {
+    // A grain stands in for the part of a cell it covers
+    const float grainArea = grainDiameter * grainDiameter;
+    const float r2 = radius * radius;
+    float totalResistance = 0.0f;
+    ForEachGrainNear(cx - radius, cy - radius, cx + radius, cy + radius, [&](size_t i) {
+        float dx = m_posX[i] - cx;
+        float dy = m_posY[i] - cy;
+        if (dx * dx + dy * dy <= r2) {
+            Cell cell = { static_cast<MaterialType>(m_types[i]), m_soaks[i] };
+            totalResistance += GetCellResistance(cell) * grainArea;
+        }
+    });
+    return totalResistance;
+}
+
+void ParticleSimulation::Displace(const glm::vec2& center, float radius) {
+    // Grains touching the proxy disk move onto its rim and lose their inward velocity
+    const float reach = radius + grainDiameter * 0.5f;
+    ForEachGrainNear(center.x - reach, center.y - reach, center.x + reach, center.y + reach, [&](size_t i) {
+        glm::vec2 offset(m_posX[i] - center.x, m_posY[i] - center.y);
+        float distance = glm::length(offset);
+        if (distance >= reach || GetMaterial(static_cast<MaterialType>(m_types[i])).mobility == Mobility::Static) return;
+
+        glm::vec2 dir = distance < 0.01f ? glm::vec2(0.0f, -1.0f) : offset / distance;
+        m_posX[i] = std::clamp(center.x + dir.x * reach, 0.0f, static_cast<float>(width));
+        m_posY[i] = std::clamp(center.y + dir.y * reach, 0.0f, static_cast<float>(height));
+        float inward = m_velX[i] * dir.x + m_velY[i] * dir.y;
+        if (inward < 0.0f) {
+            m_velX[i] -= inward * dir.x;
+            m_velY[i] -= inward * dir.y;
+        }
+    });
+}
+
+void ParticleSimulation::ExportCells(std::vector<PackedCell>& out) const {
+    out.assign(static_cast<size_t>(width) * height, PackCell(Cell{}));
+    for (size_t i = 0; i < m_posX.size(); ++i) {
+        int x = std::min(static_cast<int>(m_posX[i]), width - 1);
+        int y = std::min(static_cast<int>(m_posY[i]), height - 1);
+        out[static_cast<size_t>(y) * width + x] = PackCell({ static_cast<MaterialType>(m_types[i]), m_soaks[i] });
+    }
+}
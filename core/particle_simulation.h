@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "core/cell.h"
+#include "core/cell_storage.h"
+#include "core/random.h"
+#include "core/simulation_backend.h"
+
+class WorkerPool;
+
+// --- Particle Simulation ---
+// Discrete-element granular solver: round grains smaller than a grid cell, with
+// spring-dashpot contacts and Coulomb friction, in the same w x h cell space as the
+// cellular grid. Resistance and displacement work on grain positions, so the haptic
+// proxy feels sub-cell detail the grid cannot resolve.
+//
+// Grains live in a structure of arrays that is re-sorted by bin every substep. A bin is
+// one grain diameter tall and two wide, so every contact partner of a grain sits in two
+// adjacent bins in each of the rows above, level with and below it, and each of those
+// pairs is one contiguous run of about five grains: one AVX2 step where the CPU has it.
+// Each grain gathers its own contact forces, so threads never write to the same grain
+// and the result does not depend on the thread count.
+class ParticleSimulation final : public SimulationBackend {
+private:
+    // Grain state, in bin order
+    std::vector<float> m_posX;
+    std::vector<float> m_posY;
+    std::vector<float> m_velX;
+    std::vector<float> m_velY;
+    std::vector<float> m_forceX;
+    std::vector<float> m_forceY;
+    std::vector<float> m_friction;  // Per grain, so the kernel loads it like the positions
+    std::vector<uint8_t> m_types;
+    std::vector<uint8_t> m_soaks;
+
+    // Spatial hash: grains of bin b are [m_binStart[b], m_binStart[b + 1])
+    int m_binsX = 0;
+    int m_binsY = 0;
+    float m_binWidth = 1.0f;
+    float m_binHeight = 1.0f;
+    std::vector<uint32_t> m_binStart;
+    std::vector<uint32_t> m_binOf;
+    std::vector<uint32_t> m_order;
+    std::vector<float> m_scratch;
+    std::vector<uint8_t> m_scratchBytes;
+
+    // Erasing marks grains first and compacts once, however many cells are erased
+    std::vector<uint8_t> m_erase;
+    size_t m_eraseCount = 0;
+
+    std::unique_ptr<WorkerPool> m_pool;
+    uint64_t m_tickCount = 0;
+
+    void ResizeBins();
+    void SortIntoBins();
+    void ComputeForces(size_t first, size_t last);
+    void Integrate(size_t first, size_t last, float dt);
+    // Runs fn(first, last) over all grains, split across the worker pool
+    template <typename Fn>
+    void ForEachGrainRange(Fn&& fn);
+    // Calls fn(grain) for every grain whose bin overlaps the box, plus any added since the
+    // last sort
+    template <typename Fn>
+    void ForEachGrainNear(float minX, float minY, float maxX, float maxY, Fn&& fn) const;
+    [[nodiscard]] bool IsGrainInCell(size_t i, int x, int y) const {
+        return m_posX[i] >= x && m_posX[i] < x + 1.0f && m_posY[i] >= y && m_posY[i] < y + 1.0f;
+    }
+    // Fills cell (x, y) with grains without checking whether it holds any
+    void AddCellGrains(int x, int y, MaterialType type, int soak);
+    void MarkGrainsInCell(int x, int y);
+    void EraseMarkedGrains();
+
+public:
+    int width = INITIAL_WIDTH;
+    int height = INITIAL_HEIGHT;
+    int threadCount = 1;
+
+    // Units are cells and ticks, grain mass is 1. Water grains are frictionless and
+    // nothing soaks; soak only tints wet grains and adds to their drag.
+    float grainDiameter = 0.5f;
+    float gravity = 0.02f;
+    float stiffness = 40.0f;
+    float damping = 4.0f;
+    float friction = 0.5f;
+    int substeps = 16;
+    size_t maxGrains = 200000;
+    uint64_t seed = DEFAULT_SEED;
+
+    ParticleSimulation();
+    ~ParticleSimulation() override;
+
+    ParticleSimulation(const ParticleSimulation&) = delete;
+    ParticleSimulation& operator=(const ParticleSimulation&) = delete;
+
+    void Resize(int w, int h);
+    // Replaces the grains with ones filling every occupied cell of a packed row-major grid
+    void LoadCells(int w, int h, const std::vector<PackedCell>& cells);
+    // Adds a grain at rest; returns false once maxGrains is reached
+    bool AddGrain(float x, float y, MaterialType type, int soak);
+    [[nodiscard]] size_t GetGrainCount() const { return m_posX.size(); }
+
+    // --- Backend ---
+    void Step() override;
+    [[nodiscard]] int GetWidth() const override { return width; }
+    [[nodiscard]] int GetHeight() const override { return height; }
+    [[nodiscard]] uint64_t GetTickCount() const override { return m_tickCount; }
+    void Paint(int x, int y, MaterialType type, int soak) override;
+    void PaintStroke(const glm::vec2& from, const glm::vec2& to, float radius, MaterialType type, int soak) override;
+    void Clear() override;
+    [[nodiscard]] float GetResistance(float cx, float cy, float radius) const override;
+    void Displace(const glm::vec2& center, float radius) override;
+    // A cell shows the material of the last grain centred in it
+    void ExportCells(std::vector<PackedCell>& out) const override;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+// --- Counter-Based Random ---
+// Stateless draws keyed on (seed, tick, x, y): the same key always gives the same bits,
+// no matter which thread or engine asks, or in what order.
+
+constexpr uint64_t DEFAULT_SEED = 0x5EED5A4D5EED5A4Dull;
+
+// SplitMix64 finalizer
+constexpr uint64_t MixBits(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+constexpr uint64_t CounterRandom(uint64_t seed, uint64_t tick, int x, int y, uint64_t stream = 0) {
+    uint64_t position = (static_cast<uint64_t>(static_cast<uint32_t>(y)) << 32) | static_cast<uint32_t>(x);
+    uint64_t key = MixBits(seed + stream * 0x9E3779B97F4A7C15ull) ^ (tick * 0xD1B54A32D192ED03ull);
+    return MixBits(key ^ MixBits(position));
+}
+
+constexpr bool CounterCoinFlip(uint64_t seed, uint64_t tick, int x, int y) {
+    return (CounterRandom(seed, tick, x, y) >> 63) != 0;
+}
@@ -0,0 +1,1810 @@
+#include "core/sand_simulation.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <type_traits>
+
+#include "core/bitboard_kernel.h"
+#include "core/margolus_kernel.h"
+#include "core/worker_pool.h"
+
+namespace {
+
+thread_local int t_workerIndex = 0;
+
+// Bitboard rows draw whole 64-column words, kept apart from the per-cell draws
+constexpr uint64_t BITBOARD_STREAM = 1;
+
+constexpr uint32_t GetMobilityMask(Mobility mobility) {
+    uint32_t mask = 0;
+    for (int i = 0; i < static_cast<int>(MaterialType::Count); ++i) {
+        if (MATERIALS[i].mobility == mobility) mask |= 1u << i;
+    }
+    return mask;
+}
+
+// Heightfield beds: how often idle columns try to collapse, and the shortest bed worth
+// keeping as a height
+constexpr int BED_COLLAPSE_INTERVAL_TICKS = 16;
+constexpr int BED_MIN_ROWS = 4;
+
+// Which materials coarse blocks move, and how
+constexpr uint32_t COARSE_SOLID_MASK = GetMobilityMask(Mobility::Clump) | GetMobilityMask(Mobility::Powder);
+constexpr uint32_t COARSE_LIQUID_MASK = GetMobilityMask(Mobility::Liquid);
+constexpr uint32_t COARSE_SLIDE_MASK = GetMobilityMask(Mobility::Powder) | GetMobilityMask(Mobility::Liquid);
+
+constexpr auto SINK_MASKS = [] {
+    std::array<uint32_t, static_cast<size_t>(MaterialType::Count)> masks{};
+    for (size_t i = 0; i < masks.size(); ++i) masks[i] = GetSinkMask(static_cast<MaterialType>(i));
+    return masks;
+}();
+
+// Paged world files start with this header; cells follow at PAGED_HEADER_BYTES, which
+// keeps them page-aligned for any common page size, and the occupancy bands follow the
+// cells
+constexpr char PAGED_MAGIC[8] = { 'S', 'A', 'N', 'D', 'P', 'A', 'G', 'E' };
+constexpr uint32_t PAGED_VERSION = 2;
+constexpr size_t PAGED_HEADER_BYTES = 64 * 1024;
+// Chunks side by side in one occupancy word
+constexpr int CHUNKS_PER_WORD = bitboard::WORD_BITS / CHUNK_SIZE;
+static_assert(CHUNKS_PER_WORD * CHUNK_SIZE == bitboard::WORD_BITS, "chunks tile occupancy words");
+
+struct PagedWorldHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t bytesPerCell;
+    int32_t width;
+    int32_t height;
+    int32_t chunkSize;
+    int32_t reserved;
+    int64_t occupiedCount;
+};
+
+template <typename Storage>
+void BuildStorageRowMask(const Storage& storage, size_t rowStart, int width, MaterialType type, uint64_t* out) {
+    if constexpr (std::is_same_v<Storage, PackedCellStorage>) {
+        const PackedCell* row = storage.Data() + rowStart;
+        if (type == MaterialType::Empty) bitboard::BuildOccupancyMask(row, width, out);
+        else bitboard::BuildMaterialMask(row, width, static_cast<uint8_t>(type), out);
+    } else {
+        std::fill(out, out + bitboard::WordCount(width), 0ull);
+        for (int x = 0; x < width; ++x) {
+            MaterialType cellType = storage.Type(rowStart + x);
+            bool hit = (type == MaterialType::Empty) ? cellType != MaterialType::Empty : cellType == type;
+            if (hit) out[x / bitboard::WORD_BITS] |= 1ull << (x % bitboard::WORD_BITS);
+        }
+    }
+}
+
+template <typename Storage>
+void AdoptPackedCells(Storage& storage, CellBuffer<PackedCell>&& cells) {
+    if constexpr (std::is_same_v<Storage, PackedCellStorage>) {
+        storage.Adopt(std::move(cells));
+    } else {
+        storage.Assign(cells.Size());
+        for (size_t i = 0; i < cells.Size(); ++i) storage.Store(i, UnpackCell(cells[i]));
+    }
+}
+
+}
+
+SandSimulation::SandSimulation(uint64_t initialSeed) : seed(initialSeed) { Resize(width, height); }
+
+SandSimulation::~SandSimulation() {
+    if (m_paged) SyncPagedWorld();
+}
+
+void SandSimulation::Resize(int w, int h) {
+    if (m_paged) SyncPagedWorld();
+    m_paged = false;
+
+    width = w;
+    height = h;
+    ResetBookkeeping();
+    m_grid.Assign(GetStorageCellCount());
+    m_stamps.Assign(GetStorageCellCount(), 0);
+    m_queued.Assign(GetStorageCellCount(), 0);
+}
+
+bool SandSimulation::OpenPagedWorld(const std::string& path, int w, int h) {
+    size_t chunkCount = static_cast<size_t>((w + CHUNK_SIZE - 1) / CHUNK_SIZE) * ((h + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    size_t cellCount = chunkCount * CHUNK_CELLS;
+
+    // Mapped first, so a new file is created at its full size
+    const int chunksY = (h + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const size_t occupancyCount = static_cast<size_t>(bitboard::WordCount(w)) * chunksY * CHUNK_SIZE;
+    CellBuffer<uint64_t> occupancy;
+    if (!occupancy.MapFile(path, occupancyCount, PAGED_HEADER_BYTES + cellCount * CellStorage::BYTES_PER_CELL)) return false;
+
+    CellStorage grid;
+    if (!grid.MapFile(path, cellCount, PAGED_HEADER_BYTES)) return false;
+
+    auto* header = static_cast<PagedWorldHeader*>(grid.Header());
+    if (header->magic[0] == 0) {
+        std::memcpy(header->magic, PAGED_MAGIC, sizeof(PAGED_MAGIC));
+        header->version = PAGED_VERSION;
+        header->bytesPerCell = static_cast<uint32_t>(CellStorage::BYTES_PER_CELL);
+        header->width = w;
+        header->height = h;
+        header->chunkSize = CHUNK_SIZE;
+        header->occupiedCount = 0;
+    } else if (std::memcmp(header->magic, PAGED_MAGIC, sizeof(PAGED_MAGIC)) != 0 || header->version != PAGED_VERSION ||
+               header->bytesPerCell != CellStorage::BYTES_PER_CELL || header->width != w || header->height != h ||
+               header->chunkSize != CHUNK_SIZE) {
+        std::cerr << "[Error] OpenPagedWorld: " << path << " does not hold a " << w << "x" << h << " world" << std::endl;
+        return false;
+    }
+
+    // Stamps and queue marks only matter while a chunk is awake, so they are anonymous
+    // pages that read as zero once released
+    CellBuffer<uint8_t> stamps;
+    CellBuffer<uint8_t> queued;
+    if (!stamps.MapAnonymous(cellCount) || !queued.MapAnonymous(cellCount)) return false;
+
+    if (m_paged) SyncPagedWorld();
+    m_grid = std::move(grid);
+    m_stamps = std::move(stamps);
+    m_queued = std::move(queued);
+    m_paged = true;
+    m_layout = GridLayout::Chunked;
+
+    width = w;
+    height = h;
+    ResetBookkeeping();
+    m_occupancy = std::move(occupancy);
+    m_occupancyBandShift = CHUNK_SHIFT;
+    m_occupiedCount = header->occupiedCount;
+    return true;
+}
+
+void SandSimulation::LoadCells(int w, int h, CellBuffer<PackedCell>&& cells) {
+    if (m_paged) SyncPagedWorld();
+    m_paged = false;
+
+    width = w;
+    height = h;
+    ResetBookkeeping();
+    if (m_layout == GridLayout::RowMajor) {
+        AdoptPackedCells(m_grid, std::move(cells));
+    } else {
+        m_grid.Assign(GetStorageCellCount());
+        StoreRowMajor(cells.Data());
+    }
+    m_stamps.Assign(GetStorageCellCount(), 0);
+    m_queued.Assign(GetStorageCellCount(), 0);
+    RebuildOccupancy();
+    for (size_t i = 0; i < m_occupancy.Size(); ++i) m_occupiedCount += __builtin_popcountll(m_occupancy[i]);
+    WakeAll();
+}
+
+void SandSimulation::SyncPagedWorld() {
+    if (!m_paged) return;
+    static_cast<PagedWorldHeader*>(m_grid.Header())->occupiedCount = m_occupiedCount;
+    m_grid.Sync();
+    m_occupancy.Sync();
+}
+
+void SandSimulation::ReleaseColdChunks() {
+    if (!m_paged) return;
+
+    int focusX = static_cast<int>(std::floor(static_cast<float>(pagingFocus.x) / CHUNK_SIZE));
+    int focusY = static_cast<int>(std::floor(static_cast<float>(pagingFocus.y) / CHUNK_SIZE));
+
+    // Chunk indices follow the storage order, so runs of cold chunks are contiguous
+    // ranges; each buffer rounds a range inward to whole pages
+    int runStart = -1;
+    auto releaseRun = [this, &runStart](int runEnd) {
+        if (runStart < 0) return;
+        size_t first = static_cast<size_t>(runStart) * CHUNK_CELLS;
+        size_t count = static_cast<size_t>(runEnd - runStart) * CHUNK_CELLS;
+        m_grid.Release(first, count);
+        m_stamps.Release(first, count);
+        m_queued.Release(first, count);
+
+        // An occupancy word column spans CHUNKS_PER_WORD chunks side by side, so only
+        // columns whose chunks are all in the run go
+        const int startX = runStart % m_chunksX;
+        const int endX = (runEnd - 1) % m_chunksX + 1;
+        size_t firstColumn = static_cast<size_t>(runStart / m_chunksX) * m_occupancyWords +
+                             (startX + CHUNKS_PER_WORD - 1) / CHUNKS_PER_WORD;
+        size_t endColumn = static_cast<size_t>((runEnd - 1) / m_chunksX) * m_occupancyWords +
+                           (endX == m_chunksX ? m_occupancyWords : endX / CHUNKS_PER_WORD);
+        if (firstColumn < endColumn) {
+            m_occupancy.Release(firstColumn << m_occupancyBandShift, (endColumn - firstColumn) << m_occupancyBandShift);
+        }
+        runStart = -1;
+    };
+
+    int chunkCount = m_chunksX * m_chunksY;
+    for (int chunk = 0; chunk < chunkCount; ++chunk) {
+        int cx = chunk % m_chunksX;
+        int cy = chunk / m_chunksX;
+        bool hot = !m_rects[chunk].IsEmpty() || !m_nextRects[chunk].IsEmpty() || !m_coarseRects[chunk].IsEmpty() ||
+                   (std::abs(cx - focusX) <= residentRadius && std::abs(cy - focusY) <= residentRadius);
+        if (hot) releaseRun(chunk);
+        else if (runStart < 0) runStart = chunk;
+    }
+    releaseRun(chunkCount);
+}
+
+bool SandSimulation::SetLayout(GridLayout layout) {
+    if (layout == m_layout) return true;
+    if (m_paged) {
+        std::cerr << "[Error] SetLayout: paged worlds keep the chunked layout" << std::endl;
+        return false;
+    }
+
+    std::vector<PackedCell> cells;
+    ExportCells(cells);
+    SelectLayout(layout);
+    m_grid.Assign(GetStorageCellCount());
+    StoreRowMajor(cells.data());
+
+    // Stamps only matter within a tick; queue marks follow the worklist to its new indices
+    m_stamps.Assign(GetStorageCellCount(), 0);
+    m_queued.Assign(GetStorageCellCount(), 0);
+    int x, y;
+    for (int64_t key : m_nextActive) m_queued[GetScanKeyIndex(key, x, y)] = QUEUED_NEXT;
+    return true;
+}
+
+void SandSimulation::SelectLayout(GridLayout layout) {
+    m_layout = layout;
+    int shift = 0;
+    switch (layout) {
+        case GridLayout::Tiled:   shift = TILED_SHIFT; break;
+        case GridLayout::Chunked:
+        case GridLayout::ZOrder:  shift = CHUNK_SHIFT; break;
+        default: break;
+    }
+
+    // Square tiles of 1 << shift cells a side; row-major is the one-cell tile
+    size_t tileMask = (size_t{1} << shift) - 1;
+    size_t tilesX = (static_cast<size_t>(width) + tileMask) >> shift;
+    size_t tilesY = (static_cast<size_t>(height) + tileMask) >> shift;
+    m_storageCellCount = (tilesX * tilesY) << (2 * shift);
+
+    // Spreads the bits of a tile coordinate to the even bits, for Morton order
+    auto spread = [](size_t v) {
+        size_t out = 0;
+        for (int bit = 0; bit < CHUNK_SHIFT; ++bit) out |= ((v >> bit) & 1) << (2 * bit);
+        return out;
+    };
+
+    m_rowOffsets.resize(height);
+    m_colOffsets.resize(width);
+    for (int y = 0; y < height; ++y) {
+        size_t inTile = static_cast<size_t>(y) & tileMask;
+        inTile = layout == GridLayout::ZOrder ? spread(inTile) << 1 : inTile << shift;
+        m_rowOffsets[y] = ((static_cast<size_t>(y) >> shift) * tilesX << (2 * shift)) | inTile;
+    }
+    for (int x = 0; x < width; ++x) {
+        size_t inTile = static_cast<size_t>(x) & tileMask;
+        if (layout == GridLayout::ZOrder) inTile = spread(inTile);
+        m_colOffsets[x] = ((static_cast<size_t>(x) >> shift) << (2 * shift)) | inTile;
+    }
+}
+
+void SandSimulation::StoreRowMajor(const PackedCell* cells) {
+    for (int y = 0; y < height; ++y) {
+        const PackedCell* row = cells + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) m_grid.Store(GetIndex(x, y), UnpackCell(row[x]));
+    }
+}
+
+void SandSimulation::RebuildOccupancy() {
+    static_assert((1 << OCCUPANCY_SHIFT) == bitboard::WORD_BITS, "occupancy rows are bitboard planes");
+    for (int y = 0; y < height; ++y) BuildRowMask(y, MaterialType::Empty, &m_occupancy[GetOccupancyIndex(0, y)]);
+}
+
+void SandSimulation::ResetBookkeeping() {
+    SelectLayout(m_layout);
+    m_tick = 0;
+    m_tickCount = 0;
+
+    m_chunksX = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    m_chunksY = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    m_rects.assign(m_chunksX * m_chunksY, DirtyRect{});
+    m_nextRects.assign(m_chunksX * m_chunksY, DirtyRect{});
+    m_blockRects.assign(m_chunksX * m_chunksY, DirtyRect{});
+    m_coarse.assign(m_chunksX * m_chunksY, 0);
+    m_coarseRects.assign(m_chunksX * m_chunksY, DirtyRect{});
+    m_coarseChunkCount = 0;
+    m_coarseSeeded = false;
+    m_region = DirtyRect{};
+    m_regionTick = 0;
+    m_bedTops.assign(width, height);
+    m_bedFlags.assign(width, 0);
+    m_bedColumns = 0;
+    m_editedChunks.assign(m_chunksX * m_chunksY, 1);
+    m_occupancyWords = bitboard::WordCount(width);
+    // A paged world's bands are mapped from its file
+    if (!m_paged) {
+        m_occupancyBandShift = 0;
+        m_occupancy.Assign(static_cast<size_t>(m_occupancyWords) * height, 0);
+    }
+
+    m_sparseActive = false;
+    m_active.clear();
+    m_nextActive.clear();
+    m_passHeap.clear();
+    m_occupiedCount = 0;
+    m_levelPending = false;
+}
+
+void SandSimulation::Clear() {
+    m_grid.Fill(Cell{ MaterialType::Empty });
+    std::fill(m_rects.begin(), m_rects.end(), DirtyRect{});
+    std::fill(m_nextRects.begin(), m_nextRects.end(), DirtyRect{});
+    std::fill(m_coarseRects.begin(), m_coarseRects.end(), DirtyRect{});
+    std::fill(m_bedTops.begin(), m_bedTops.end(), height);
+    std::fill(m_bedFlags.begin(), m_bedFlags.end(), 0);
+    m_bedColumns = 0;
+    std::fill(m_editedChunks.begin(), m_editedChunks.end(), 1);
+    m_occupancy.Fill(0);
+
+    ClearWorklist();
+    m_occupiedCount = 0;
+    m_levelPending = false;
+}
+
+void SandSimulation::WakeRectSlow(int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width - 1);
+    y1 = std::min(y1, height - 1);
+    if (x0 > x1 || y0 > y1) return;
+
+    if (m_inParallelPhase) m_wakeQueues[t_workerIndex].push_back(DirtyRect{ x0, y0, x1, y1 });
+    if (m_inParallelPhase && m_passPhase == NO_PASS) return;
+
+    for (int cy = y0 / CHUNK_SIZE; cy <= y1 / CHUNK_SIZE; ++cy) {
+        int chunkMinY = cy * CHUNK_SIZE;
+        int chunkMaxY = chunkMinY + CHUNK_SIZE - 1;
+        for (int cx = x0 / CHUNK_SIZE; cx <= x1 / CHUNK_SIZE; ++cx) {
+            int chunkMinX = cx * CHUNK_SIZE;
+            int chunkMaxX = chunkMinX + CHUNK_SIZE - 1;
+            const int chunkIndex = cy * m_chunksX + cx;
+            const DirtyRect part = { std::max(x0, chunkMinX), std::max(y0, chunkMinY),
+                                     std::min(x1, chunkMaxX), std::min(y1, chunkMaxY) };
+            // A worker's queued wakes reach the next tick's rects through the merge
+            if (!m_inParallelPhase) m_nextRects[chunkIndex].Include(part.minX, part.minY, part.maxX, part.maxY);
+            if (IsAheadOfPass(cx, cy) && !m_coarse[chunkIndex]) {
+                m_rects[chunkIndex].Include(part.minX, part.minY, part.maxX, part.maxY);
+            }
+        }
+    }
+}
+
+void SandSimulation::AddOccupied(int64_t delta) {
+    if (m_inParallelPhase) m_occupiedDeltas[t_workerIndex] += delta;
+    else m_occupiedCount += delta;
+}
+
+void SandSimulation::QueueRect(int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width - 1);
+    y1 = std::min(y1, height - 1);
+
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = NextOccupied(x0, y, x1); x <= x1; x = NextOccupied(x + 1, y, x1)) {
+            size_t idx = GetIndex(x, y);
+            int64_t key = GetScanKey(x, y);
+            if (!(m_queued[idx] & QUEUED_NEXT)) {
+                m_queued[idx] |= QUEUED_NEXT;
+                m_nextActive.push_back(key);
+            }
+            if (key > m_passCursor && !(m_queued[idx] & QUEUED_PASS)) {
+                m_queued[idx] |= QUEUED_PASS;
+                m_passHeap.push_back(key);
+                std::push_heap(m_passHeap.begin(), m_passHeap.end(), std::greater<int64_t>());
+            }
+        }
+    }
+}
+
+void SandSimulation::WakeAll() {
+    WakeRect(0, 0, width - 1, height - 1);
+}
+
+void SandSimulation::ExportCells(std::vector<PackedCell>& out) const {
+    out.resize(static_cast<size_t>(width) * height);
+    if (m_layout == GridLayout::RowMajor) {
+        m_grid.CopyPacked(out.data());
+        return;
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) out[static_cast<size_t>(y) * width + x] = PackCell(m_grid.Load(GetIndex(x, y)));
+    }
+}
+
+void SandSimulation::ExportChunk(int cx, int cy, PackedCell* out) const {
+    std::fill(out, out + CHUNK_CELLS, PackedCell{0});
+    const int x0 = cx * CHUNK_SIZE;
+    const int y0 = cy * CHUNK_SIZE;
+    const int x1 = std::min(x0 + CHUNK_SIZE, width);
+    const int y1 = std::min(y0 + CHUNK_SIZE, height);
+    for (int y = y0; y < y1; ++y) {
+        PackedCell* row = out + (y - y0) * CHUNK_SIZE - x0;
+        for (int x = x0; x < x1; ++x) row[x] = PackCell(m_grid.Load(GetIndex(x, y)));
+    }
+}
+
+void SandSimulation::NoteEditedChunks() {
+    for (size_t i = 0; i < m_nextRects.size(); ++i) {
+        if (!m_nextRects[i].IsEmpty()) m_editedChunks[i] = 1;
+    }
+}
+
+void SandSimulation::TakeEditedChunks(std::vector<uint8_t>& out) {
+    NoteEditedChunks();
+    out.assign(m_editedChunks.begin(), m_editedChunks.end());
+    std::fill(m_editedChunks.begin(), m_editedChunks.end(), 0);
+}
+
+void SandSimulation::ExportOccupancy(std::vector<uint64_t>& out) const {
+    out.resize(static_cast<size_t>(m_occupancyWords) * height);
+    for (int y = 0; y < height; ++y) {
+        for (int w = 0; w < m_occupancyWords; ++w) {
+            out[static_cast<size_t>(y) * m_occupancyWords + w] = m_occupancy[GetOccupancyIndex(w << OCCUPANCY_SHIFT, y)];
+        }
+    }
+}
+
+uint64_t SandSimulation::ComputeGridHash() const {
+    uint64_t hash = MixBits(static_cast<uint64_t>(width) << 32 | static_cast<uint32_t>(height));
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            Cell cell = m_grid.Load(GetIndex(x, y));
+            hash = MixBits(hash ^ PackCell(cell));
+        }
+    }
+    return hash;
+}
+
+int SandSimulation::GetAwakeChunkCount() const {
+    int count = 0;
+    for (size_t i = 0; i < m_rects.size(); ++i) {
+        if (!m_rects[i].IsEmpty() || !m_coarseRects[i].IsEmpty()) ++count;
+    }
+    return count;
+}
+
+float SandSimulation::GetResistance(float cx, float cy, float radius) const {
+    float totalResistance = 0.0f;
+    float r2 = radius * radius;
+
+    // Clamped to the grid, so the loop body needs no bounds test
+    int minX = std::max(static_cast<int>(std::floor(cx - radius)), 0);
+    int maxX = std::min(static_cast<int>(std::ceil(cx + radius)), width - 1);
+    int minY = std::max(static_cast<int>(std::floor(cy - radius)), 0);
+    int maxY = std::min(static_cast<int>(std::ceil(cy + radius)), height - 1);
+
+    for (int y = minY; y <= maxY; ++y) {
+        float dy = static_cast<float>(y) - cy;
+        for (int x = minX; x <= maxX; ++x) {
+            float dx = static_cast<float>(x) - cx;
+
+            if (dx*dx + dy*dy <= r2) totalResistance += GetCellResistance(m_grid.Load(GetIndex(x, y)));
+        }
+    }
+    return totalResistance;
+}
+
+glm::ivec2 SandSimulation::FindNearestEmpty(int targetX, int targetY, int maxRadius) const {
+    if (IsInBounds(targetX, targetY) && !IsOccupied(targetX, targetY)) {
+        return glm::ivec2(targetX, targetY);
+    }
+
+    // Rings top row first, then the two sides row by row, then the bottom row, each left
+    // to right; the top and bottom rows are searched a word at a time
+    auto searchRow = [this](int y, int x0, int x1) {
+        if (y < 0 || y >= height) return -1;
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, width - 1);
+        int x = NextEmpty(x0, y, x1);
+        return x <= x1 ? x : -1;
+    };
+    for (int r = 1; r <= maxRadius; ++r) {
+        int x = searchRow(targetY - r, targetX - r, targetX + r);
+        if (x >= 0) return glm::ivec2(x, targetY - r);
+
+        for (int y = std::max(targetY - r + 1, 0); y <= std::min(targetY + r - 1, height - 1); ++y) {
+            if (IsInBounds(targetX - r, y) && !IsOccupied(targetX - r, y)) return glm::ivec2(targetX - r, y);
+            if (IsInBounds(targetX + r, y) && !IsOccupied(targetX + r, y)) return glm::ivec2(targetX + r, y);
+        }
+
+        x = searchRow(targetY + r, targetX - r, targetX + r);
+        if (x >= 0) return glm::ivec2(x, targetY + r);
+    }
+    return glm::ivec2(-1, -1);
+}
+
+void SandSimulation::Displace(const glm::vec2& center, float radius) {
+    refineFocus = glm::ivec2(center);
+
+    int r = static_cast<int>(std::ceil(radius));
+    int px = static_cast<int>(center.x);
+    int py = static_cast<int>(center.y);
+    float rSq = radius * radius;
+
+    for (int y = py - r; y <= py + r; ++y) {
+        for (int x = px - r; x <= px + r; ++x) {
+            if (Get(x, y).type != MaterialType::Empty) {
+                float dx = static_cast<float>(x) - center.x;
+                float dy = static_cast<float>(y) - center.y;
+
+                if (dx*dx + dy*dy <= rSq) {
+                    glm::vec2 dir(dx, dy);
+                    if (glm::length(dir) < 0.01f) dir = glm::vec2(0, -1);
+                    else dir = glm::normalize(dir);
+
+                    glm::vec2 target = center + dir * (radius + 1.5f);
+                    glm::ivec2 best = FindNearestEmpty(static_cast<int>(target.x), static_cast<int>(target.y), 3);
+                    if (best.x != -1) Move(x, y, best.x, best.y);
+                }
+            }
+        }
+    }
+}
+
+void SandSimulation::AdvanceStamp() {
+    // Stamps are 8 bit; forget stale ones when the counter wraps
+    if (++m_tick == 0) {
+        m_stamps.Fill(0);
+        m_tick = 1;
+    }
+}
+
+void SandSimulation::Update() {
+    ++m_tickCount;
+    m_regionTick = 0;
+    AdvanceStamp();
+
+    bool sparse = WantsSparse();
+    if (sparse != m_sparseActive) SetSparseActive(sparse);
+
+    NoteEditedChunks();
+    if (!chunkSleeping) WakeAll();
+    // Margolus keeps last tick's rects; m_blockRects is the same size and its old
+    // contents are cleared along with m_nextRects
+    if (engine == UpdateEngine::Margolus) m_blockRects.swap(m_rects);
+    m_rects.swap(m_nextRects);
+    std::fill(m_nextRects.begin(), m_nextRects.end(), DirtyRect{});
+    if (UsesHeightfield() || m_bedColumns > 0) UpdateHeightfield();
+    if (HasRegion()) {
+        for (int y = m_region.minY; y <= m_region.maxY; ++y) {
+            for (int x = m_region.minX; x <= m_region.maxX; ++x) m_stamps[GetIndex(x, y)] = m_tick;
+        }
+    }
+    if (multiResolution || m_coarseChunkCount > 0) RouteCoarseChunks();
+    if (m_coarseChunkCount > 0 && m_tickCount % COARSE_TICKS == 0) UpdateCoarse();
+
+    if (m_sparseActive) UpdateSparse();
+    else if (engine == UpdateEngine::Margolus) UpdateMargolus();
+    else if (UsesBitboard()) UpdateBitboard();
+    else UpdatePhased();
+
+    if (IsHydrostatic()) {
+        m_levelPending = m_levelPending || IsWaterAwake();
+        if (m_levelPending && m_tickCount % std::max(waterLevelIntervalTicks, 1) == 0) {
+            LevelWater();
+            m_levelPending = false;
+        }
+    }
+
+    if (m_paged && releaseIntervalTicks > 0 && m_tickCount % releaseIntervalTicks == 0) ReleaseColdChunks();
+}
+
+bool SandSimulation::SetRegion(const DirtyRect& region) {
+    DirtyRect clamped;
+    if (!region.IsEmpty()) {
+        clamped = { std::max(region.minX, 0), std::max(region.minY, 0),
+                    std::min(region.maxX, width - 1), std::min(region.maxY, height - 1) };
+        if (clamped.IsEmpty() || clamped.minY > clamped.maxY) clamped = DirtyRect{};
+    }
+    bool changed = clamped.minX != m_region.minX || clamped.minY != m_region.minY ||
+                   clamped.maxX != m_region.maxX || clamped.maxY != m_region.maxY;
+    m_region = clamped;
+    return changed;
+}
+
+void SandSimulation::UpdateRegion() {
+    if (!HasRegion()) return;
+    ++m_regionTick;
+    AdvanceStamp();
+
+    // Same bottom-up, left-to-right order as a full scan. Coarse chunks keep their blocks
+    // packed and are left to UpdateCoarse.
+    for (int y = m_region.maxY; y >= m_region.minY; --y) {
+        const int cy = y >> CHUNK_SHIFT;
+        for (int x0 = m_region.minX; x0 <= m_region.maxX;) {
+            const int cx = x0 >> CHUNK_SHIFT;
+            const int x1 = std::min(m_region.maxX, ((cx + 1) << CHUNK_SHIFT) - 1);
+            if (!IsChunkCoarse(cx, cy)) UpdateSpan(y, x0, x1);
+            x0 = x1 + 1;
+        }
+    }
+}
+
+bool SandSimulation::WantsSparse() const {
+    if (UsesBitboard() || engine == UpdateEngine::Margolus || multiResolution) return false;
+
+    switch (worklistMode) {
+        case WorklistMode::Dense:  return false;
+        case WorklistMode::Sparse: return true;
+        default: break;
+    }
+    double fill = static_cast<double>(m_occupiedCount) / std::max(static_cast<double>(width) * height, 1.0);
+    return fill < (m_sparseActive ? SPARSE_EXIT_FILL : SPARSE_ENTER_FILL);
+}
+
+void SandSimulation::SetSparseActive(bool active) {
+    m_sparseActive = active;
+    if (active) {
+        // Everything the dense scan would visit next tick seeds the worklist
+        for (const DirtyRect& rect : m_nextRects) {
+            if (!rect.IsEmpty()) QueueRect(rect.minX, rect.minY, rect.maxX, rect.maxY);
+        }
+    } else {
+        ClearWorklist();
+    }
+}
+
+void SandSimulation::ClearWorklist() {
+    int x, y;
+    for (int64_t key : m_nextActive) m_queued[GetScanKeyIndex(key, x, y)] = 0;
+    m_nextActive.clear();
+}
+
+void SandSimulation::UpdateSparse() {
+    // Cost is proportional to the woken particles, not to the area they are spread over
+    m_active.swap(m_nextActive);
+    m_nextActive.clear();
+    std::sort(m_active.begin(), m_active.end());
+    int x, y;
+    for (int64_t key : m_active) m_queued[GetScanKeyIndex(key, x, y)] = QUEUED_PASS;
+
+    // Merge the sorted worklist with cells woken ahead of the cursor during the pass
+    size_t next = 0;
+    for (;;) {
+        int64_t key;
+        if (!m_passHeap.empty() && (next == m_active.size() || m_passHeap.front() < m_active[next])) {
+            key = m_passHeap.front();
+            std::pop_heap(m_passHeap.begin(), m_passHeap.end(), std::greater<int64_t>());
+            m_passHeap.pop_back();
+        } else if (next < m_active.size()) {
+            key = m_active[next++];
+        } else {
+            break;
+        }
+
+        m_passCursor = key;
+        m_queued[GetScanKeyIndex(key, x, y)] &= ~QUEUED_PASS;
+        UpdateSpan(y, x, x);
+    }
+    m_passCursor = INT64_MAX;
+}
+
+template <typename Fn>
+void SandSimulation::ForEachChunkPhased(const std::vector<DirtyRect>& rects, Fn&& update, bool pickUpWakes) {
+    if (!m_pool || m_pool->GetThreadCount() != threadCount) {
+        m_pool = std::make_unique<WorkerPool>(threadCount);
+        m_wakeQueues.assign(threadCount, {});
+        m_occupiedDeltas.assign(threadCount, 0);
+    }
+
+    // Bottom chunk rows go first within each phase
+    for (int phase = 0; phase < 4; ++phase) {
+        m_phaseChunks.clear();
+        for (int cy = m_chunksY - 1; cy >= 0; --cy) {
+            if ((cy & 1) != (phase >> 1)) continue;
+            for (int cx = phase & 1; cx < m_chunksX; cx += 2) {
+                int chunkIndex = cy * m_chunksX + cx;
+                if (!rects[chunkIndex].IsEmpty()) m_phaseChunks.push_back(chunkIndex);
+            }
+        }
+
+        if (pickUpWakes) m_passPhase = phase;
+        m_inParallelPhase = true;
+        m_pool->ParallelFor(static_cast<int>(m_phaseChunks.size()), [this, &update](int item, int worker) {
+            t_workerIndex = worker;
+            update(m_phaseChunks[item], worker);
+        });
+        m_inParallelPhase = false;
+
+        if (pickUpWakes) m_passPhase = phase + 1;
+        for (std::vector<DirtyRect>& queue : m_wakeQueues) {
+            for (const DirtyRect& rect : queue) WakeRectSlow(rect.minX, rect.minY, rect.maxX, rect.maxY);
+            queue.clear();
+        }
+    }
+    m_passPhase = NO_PASS;
+}
+
+void SandSimulation::UpdatePhased() {
+    // Wetting uses up water through Set, which counts into the worker's slot
+    ForEachChunkPhased(m_rects, [this](int chunkIndex, int) { UpdateChunk(chunkIndex); }, true);
+    for (int64_t& delta : m_occupiedDeltas) {
+        m_occupiedCount += delta;
+        delta = 0;
+    }
+}
+
+void SandSimulation::UpdateChunk(int chunkIndex) {
+    // The bounds are read again as the scan goes: a wake in a row above, or further along
+    // the current row, widens the rect and is handled in this pass
+    const DirtyRect& rect = m_rects[chunkIndex];
+    for (int y = rect.maxY; y >= rect.minY; --y) {
+        for (int x = rect.minX, end = rect.maxX; x <= end; end = rect.maxX) {
+            UpdateSpan(y, x, end);
+            x = end + 1;
+        }
+    }
+}
+
+void SandSimulation::UpdateBitboard() {
+    const int words = bitboard::WordCount(width);
+    m_planes.resize(static_cast<size_t>(words) * 8);
+    uint64_t* sand = &m_planes[0];
+    uint64_t* belowWater = sand + words;
+    uint64_t* random = belowWater + words;
+    uint64_t* other = random + words;
+    uint64_t* scratch = other + words;
+    bitboard::SandMoves moves = { scratch + words, scratch + 2 * words, scratch + 3 * words, scratch };
+
+    auto forEachBit = [words](const uint64_t* plane, auto&& fn) {
+        for (int w = 0; w < words; ++w) {
+            for (uint64_t bits = plane[w]; bits != 0; bits &= bits - 1) {
+                fn(w * bitboard::WORD_BITS + __builtin_ctzll(bits));
+            }
+        }
+    };
+
+    for (int y = height - 1; y >= 0; --y) {
+        if (!IsRowAwake(y)) continue;
+
+        if (y + 1 < height) {
+            BuildRowMask(y, MaterialType::Sand, sand);
+            BuildRowMask(y + 1, MaterialType::Water, belowWater);
+            const uint64_t* belowOccupied = &m_occupancy[GetOccupancyIndex(0, y + 1)];
+            for (int w = 0; w < words; ++w) {
+                random[w] = CounterRandom(seed, m_tickCount, w, y, BITBOARD_STREAM);
+            }
+
+            bitboard::ComputeSandMoves(sand, belowOccupied, belowWater, random, width, moves);
+
+            // Moves are conflict-free by construction, so write storage directly and wake
+            // once per word instead of going through Move/Swap for every grain. Swaps trade
+            // sand for water, which leaves occupancy as it was.
+            const size_t row = GetIndex(0, y);
+            const size_t rowBelow = GetIndex(0, y + 1);
+            forEachBit(moves.down, [&](int x) { m_grid.Move(row + x, rowBelow + x); });
+            forEachBit(moves.swapDown, [&](int x) { m_grid.Swap(row + x, rowBelow + x); });
+            forEachBit(moves.left, [&](int x) {
+                m_grid.Move(row + x, rowBelow + x - 1);
+                MarkOccupied(x - 1, y + 1, true);
+            });
+            forEachBit(moves.right, [&](int x) {
+                m_grid.Move(row + x, rowBelow + x + 1);
+                MarkOccupied(x + 1, y + 1, true);
+            });
+            uint64_t* occupied = &m_occupancy[GetOccupancyIndex(0, y)];
+            uint64_t* occupiedBelow = &m_occupancy[GetOccupancyIndex(0, y + 1)];
+            for (int w = 0; w < words; ++w) {
+                occupied[w] &= ~(moves.down[w] | moves.left[w] | moves.right[w]);
+                occupiedBelow[w] |= moves.down[w];
+            }
+
+            for (int w = 0; w < words; ++w) {
+                uint64_t moved = moves.down[w] | moves.swapDown[w] | moves.left[w] | moves.right[w];
+                if (moved == 0) continue;
+                int lo = w * bitboard::WORD_BITS + __builtin_ctzll(moved);
+                int hi = w * bitboard::WORD_BITS + (bitboard::WORD_BITS - 1 - __builtin_clzll(moved));
+                WakeRect(lo - 2, y - 2, hi + 2, y + 2);
+            }
+        }
+
+        // Wet sand and water keep their scalar rules, after the row's dry sand has moved.
+        // Water that just swapped up into this row has already had its turn.
+        BuildRowMask(y, MaterialType::WetSand, other);
+        BuildRowMask(y, MaterialType::Water, scratch);
+        for (int w = 0; w < words; ++w) {
+            other[w] |= scratch[w];
+            if (y + 1 < height) other[w] &= ~moves.swapDown[w];
+        }
+        forEachBit(other, [&](int x) { UpdateSpan(y, x, x); });
+    }
+}
+
+bool SandSimulation::IsRowAwake(int y) const {
+    const DirtyRect* rowRects = &m_rects[(y / CHUNK_SIZE) * m_chunksX];
+    for (int cx = 0; cx < m_chunksX; ++cx) {
+        const DirtyRect& rect = rowRects[cx];
+        if (!rect.IsEmpty() && y >= rect.minY && y <= rect.maxY) return true;
+    }
+    return false;
+}
+
+// MaterialType::Empty builds the occupancy plane (every non-empty cell)
+void SandSimulation::BuildRowMask(int y, MaterialType type, uint64_t* out) const {
+    if (m_layout == GridLayout::RowMajor) {
+        BuildStorageRowMask(m_grid, GetIndex(0, y), width, type, out);
+        return;
+    }
+    std::fill(out, out + bitboard::WordCount(width), 0ull);
+    for (int x = 0; x < width; ++x) {
+        MaterialType cellType = m_grid.Type(GetIndex(x, y));
+        bool hit = (type == MaterialType::Empty) ? cellType != MaterialType::Empty : cellType == type;
+        if (hit) out[x / bitboard::WORD_BITS] |= 1ull << (x % bitboard::WORD_BITS);
+    }
+}
+
+void SandSimulation::UpdateSpan(int y, int x0, int x1) {
+    if (m_bedColumns == 0) {
+        UpdateRun(y, x0, x1);
+        return;
+    }
+    while (x0 <= x1) {
+        while (x0 <= x1 && y >= m_bedTops[x0]) ++x0;
+        int end = x0;
+        while (end <= x1 && y < m_bedTops[end]) ++end;
+        if (x0 < end) UpdateRun(y, x0, end - 1);
+        x0 = end;
+    }
+}
+
+void SandSimulation::UpdateRun(int y, int x0, int x1) {
+    // Empty cells have no rules, so only occupied ones are visited. The row's bits are
+    // read again after every cell, so a cell written ahead of the scan is seen exactly as
+    // a cell-by-cell scan would see it.
+    const bool interiorRow = IsInteriorRow(y);
+    for (int x = NextOccupied(x0, y, x1); x <= x1; x = NextOccupied(x + 1, y, x1)) {
+        if (interiorRow && x >= 1 && x < width - 1) UpdateCell<true>(x, y);
+        else UpdateCell<false>(x, y);
+    }
+}
+
+template <bool Interior>
+void SandSimulation::UpdateCell(int x, int y) {
+    size_t idx = GetIndex(x, y);
+    if (m_stamps[idx] == m_tick) return;
+
+    // No default: -Wswitch flags a material without a kernel
+    switch (m_grid.Type(idx)) {
+        case MaterialType::Empty:   UpdateMaterial<MaterialType::Empty, Interior>(x, y); break;
+        case MaterialType::Sand:    UpdateMaterial<MaterialType::Sand, Interior>(x, y); break;
+        case MaterialType::WetSand: UpdateMaterial<MaterialType::WetSand, Interior>(x, y); break;
+        case MaterialType::Water:   UpdateMaterial<MaterialType::Water, Interior>(x, y); break;
+        case MaterialType::Count:   break;
+    }
+}
+
+template <MaterialType Type, bool Interior>
+void SandSimulation::UpdateMaterial(int x, int y) {
+    constexpr MaterialDesc desc = GetMaterial(Type);
+    constexpr uint32_t sinkMask = GetSinkMask(Type);
+
+    if constexpr (desc.mobility == Mobility::Static) {
+        return;
+    } else {
+        if constexpr (desc.wets) {
+            if (TryWet<Type, Interior>(x, y)) return;
+        }
+        if (!Interior && y + 1 >= height) return;
+
+        MaterialType below = GetType(x, y + 1);
+        if (below == MaterialType::Empty) { MoveToEmpty(x, y, x, y + 1); return; }
+        if constexpr (sinkMask != 0) {
+            if ((sinkMask >> static_cast<int>(below)) & 1) { SwapCells(x, y, x, y + 1); return; }
+        }
+        if constexpr (desc.mobility == Mobility::Clump) return;
+
+        bool left = (Interior || x - 1 >= 0) && GetType(x - 1, y + 1) == MaterialType::Empty;
+        bool right = (Interior || x + 1 < width) && GetType(x + 1, y + 1) == MaterialType::Empty;
+        if (left && right) { MoveToEmpty(x, y, CoinFlip(x, y) ? x - 1 : x + 1, y + 1); return; }
+        if (left) { MoveToEmpty(x, y, x - 1, y + 1); return; }
+        if (right) { MoveToEmpty(x, y, x + 1, y + 1); return; }
+
+        // Hydrostatic leveling moves liquid sideways in bulk instead
+        if constexpr (desc.mobility == Mobility::Liquid) {
+            if (IsHydrostatic()) return;
+
+            bool lSide = (Interior || x - 1 >= 0) && GetType(x - 1, y) == MaterialType::Empty;
+            bool rSide = (Interior || x + 1 < width) && GetType(x + 1, y) == MaterialType::Empty;
+            if (lSide && rSide) MoveToEmpty(x, y, CoinFlip(x, y) ? x - 1 : x + 1, y);
+            else if (lSide) MoveToEmpty(x, y, x - 1, y);
+            else if (rSide) MoveToEmpty(x, y, x + 1, y);
+        }
+    }
+}
+
+template <MaterialType Type, bool Interior>
+bool SandSimulation::TryWet(int wx, int wy) {
+    constexpr MaterialDesc desc = GetMaterial(Type);
+
+    for (const auto& o : WET_OFFSETS) {
+        int sx = wx + o[0];
+        int sy = wy + o[1];
+
+        if (!Interior && !IsInBounds(sx, sy)) continue;
+
+        Cell cell = m_grid.Load(GetIndex(sx, sy));
+        const MaterialDesc& target = GetMaterial(cell.type);
+        if (target.wetForm == MaterialType::Empty) continue;
+
+        if (cell.soak < target.maxSoak) {
+            Set(sx, sy, target.wetForm, cell.soak + 1);
+            Set(wx, wy, MaterialType::Empty, 0);
+            return true;
+        }
+        // Saturated cells above sink through the liquid instead
+        if (target.density > desc.density && sy < wy) {
+            SwapCells(wx, wy, sx, sy);
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- Bulk Edits ---
+
+void SandSimulation::FillSpan(int y, int x0, int x1, const Cell& cell) {
+    if (m_bedColumns > 0) {
+        for (int x = x0; x <= x1; ++x) NoteBedWrite(x, y);
+    }
+    const int64_t filled = cell.type != MaterialType::Empty;
+    MarkOccupiedSpan(y, x0, x1, filled != 0);
+    if (m_layout == GridLayout::RowMajor) {
+        const size_t first = GetIndex(x0, y);
+        const size_t count = static_cast<size_t>(x1 - x0 + 1);
+        m_occupiedCount += filled * static_cast<int64_t>(count) - static_cast<int64_t>(m_grid.CountOccupied(first, count));
+        m_grid.FillRange(first, count, cell);
+        return;
+    }
+    for (int x = x0; x <= x1; ++x) {
+        const size_t idx = GetIndex(x, y);
+        m_occupiedCount += filled - (m_grid.Type(idx) != MaterialType::Empty);
+        m_grid.Store(idx, cell);
+    }
+}
+
+void SandSimulation::CopySpan(int y, int x0, int x1, const PackedCell* cells, bool skipEmpty) {
+    if (m_bedColumns > 0) {
+        for (int x = x0; x <= x1; ++x) {
+            if (!skipEmpty || (cells[x - x0] & 0x0F) != 0) NoteBedWrite(x, y);
+        }
+    }
+    CopyOccupancy(y, x0, x1, cells, skipEmpty);
+    if (m_layout == GridLayout::RowMajor) {
+        const size_t first = GetIndex(x0, y);
+        const size_t count = static_cast<size_t>(x1 - x0 + 1);
+        if (skipEmpty) {
+            m_occupiedCount += m_grid.StampPacked(first, count, cells);
+            return;
+        }
+        int64_t occupied = 0;
+        for (size_t i = 0; i < count; ++i) occupied += (cells[i] & 0x0F) != 0;
+        m_occupiedCount += occupied - static_cast<int64_t>(m_grid.CountOccupied(first, count));
+        m_grid.StorePacked(first, count, cells);
+        return;
+    }
+    for (int x = x0; x <= x1; ++x) {
+        const Cell cell = UnpackCell(cells[x - x0]);
+        if (skipEmpty && cell.type == MaterialType::Empty) continue;
+        const size_t idx = GetIndex(x, y);
+        m_occupiedCount += (cell.type != MaterialType::Empty) - (m_grid.Type(idx) != MaterialType::Empty);
+        m_grid.Store(idx, cell);
+    }
+}
+
+void SandSimulation::MarkOccupiedSpan(int y, int x0, int x1, bool occupied) {
+    uint64_t* row = &m_occupancy[GetOccupancyIndex(0, y)];
+    const int first = x0 >> OCCUPANCY_SHIFT;
+    const int last = x1 >> OCCUPANCY_SHIFT;
+    for (int w = first; w <= last; ++w) {
+        uint64_t mask = ~0ull;
+        if (w == first) mask &= ~0ull << (x0 & OCCUPANCY_MASK);
+        if (w == last) mask &= ~0ull >> (OCCUPANCY_MASK - (x1 & OCCUPANCY_MASK));
+        uint64_t& word = row[static_cast<size_t>(w) << m_occupancyBandShift];
+        word = occupied ? word | mask : word & ~mask;
+    }
+}
+
+void SandSimulation::CopyOccupancy(int y, int x0, int x1, const PackedCell* cells, bool skipEmpty) {
+    // Stamps keep what lies under their empty cells
+    if (!skipEmpty) MarkOccupiedSpan(y, x0, x1, false);
+
+    // The span's own plane, shifted into place word by word
+    const int words = bitboard::WordCount(x1 - x0 + 1);
+    if (m_planes.size() < static_cast<size_t>(words)) m_planes.resize(words);
+    bitboard::BuildOccupancyMask(cells, x1 - x0 + 1, m_planes.data());
+    uint64_t* row = &m_occupancy[GetOccupancyIndex(x0, y)];
+    auto word = [this, row](int w) -> uint64_t& { return row[static_cast<size_t>(w) << m_occupancyBandShift]; };
+    const int shift = x0 & OCCUPANCY_MASK;
+    const int lastWord = (x1 >> OCCUPANCY_SHIFT) - (x0 >> OCCUPANCY_SHIFT);
+    for (int w = 0; w < words; ++w) {
+        word(w) |= m_planes[w] << shift;
+        if (shift != 0 && w < lastWord) word(w + 1) |= m_planes[w] >> (bitboard::WORD_BITS - shift);
+    }
+}
+
+void SandSimulation::FillRect(int x0, int y0, int x1, int y1, MaterialType type, int soak) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width - 1);
+    y1 = std::min(y1, height - 1);
+    if (x0 > x1 || y0 > y1) return;
+
+    for (int y = y0; y <= y1; ++y) FillSpan(y, x0, x1, { type, soak });
+    WakeRect(x0 - 1, y0 - 2, x1 + 1, y1 + 1);
+}
+
+void SandSimulation::FillCircle(const glm::vec2& center, float radius, MaterialType type, int soak) {
+    if (radius < 0.0f) return;
+    const float r2 = radius * radius;
+    const int y0 = std::max(static_cast<int>(std::ceil(center.y - radius)), 0);
+    const int y1 = std::min(static_cast<int>(std::floor(center.y + radius)), height - 1);
+    int minX = width;
+    int maxX = -1;
+    for (int y = y0; y <= y1; ++y) {
+        const float dy = static_cast<float>(y) - center.y;
+        const float half = std::sqrt(std::max(r2 - dy * dy, 0.0f));
+        const int x0 = std::max(static_cast<int>(std::ceil(center.x - half)), 0);
+        const int x1 = std::min(static_cast<int>(std::floor(center.x + half)), width - 1);
+        if (x0 > x1) continue;
+        FillSpan(y, x0, x1, { type, soak });
+        minX = std::min(minX, x0);
+        maxX = std::max(maxX, x1);
+    }
+    if (minX <= maxX) WakeRect(minX - 1, y0 - 2, maxX + 1, y1 + 1);
+}
+
+void SandSimulation::FillPolygon(const std::vector<glm::vec2>& points, MaterialType type, int soak) {
+    if (points.size() < 3) return;
+    float minY = points[0].y;
+    float maxY = points[0].y;
+    for (const glm::vec2& point : points) {
+        minY = std::min(minY, point.y);
+        maxY = std::max(maxY, point.y);
+    }
+    const int y0 = std::max(static_cast<int>(std::ceil(minY)), 0);
+    const int y1 = std::min(static_cast<int>(std::floor(maxY)), height - 1);
+
+    // Each row's crossings pair up into the spans inside the polygon. An edge counts
+    // rows from its lower end up to but not including its upper one, so a vertex on a
+    // row is crossed once.
+    std::vector<float> crossings;
+    int minX = width;
+    int maxX = -1;
+    for (int y = y0; y <= y1; ++y) {
+        const float fy = static_cast<float>(y);
+        crossings.clear();
+        for (size_t i = 0; i < points.size(); ++i) {
+            const glm::vec2& a = points[i];
+            const glm::vec2& b = points[(i + 1) % points.size()];
+            if ((a.y <= fy) == (b.y <= fy)) continue;
+            crossings.push_back(a.x + (fy - a.y) * (b.x - a.x) / (b.y - a.y));
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            const int x0 = std::max(static_cast<int>(std::ceil(crossings[i])), 0);
+            const int x1 = std::min(static_cast<int>(std::floor(crossings[i + 1])), width - 1);
+            if (x0 > x1) continue;
+            FillSpan(y, x0, x1, { type, soak });
+            minX = std::min(minX, x0);
+            maxX = std::max(maxX, x1);
+        }
+    }
+    if (minX <= maxX) WakeRect(minX - 1, y0 - 2, maxX + 1, y1 + 1);
+}
+
+void SandSimulation::FillLine(const glm::vec2& a, const glm::vec2& b, float radius, MaterialType type, int soak) {
+    // A capsule: the band either side of the segment plus a disk at each end
+    FillCircle(a, radius, type, soak);
+    const glm::vec2 along = b - a;
+    const float length = glm::length(along);
+    if (length < 1e-4f) return;
+    const glm::vec2 side = glm::vec2(-along.y, along.x) * (radius / length);
+    FillPolygon({ a + side, b + side, b - side, a - side }, type, soak);
+    FillCircle(b, radius, type, soak);
+}
+
+void SandSimulation::CopyRegion(int x, int y, int w, int h, const PackedCell* cells, bool skipEmpty) {
+    const int x0 = std::max(x, 0);
+    const int y0 = std::max(y, 0);
+    const int x1 = std::min(x + w, width) - 1;
+    const int y1 = std::min(y + h, height) - 1;
+    if (x0 > x1 || y0 > y1) return;
+
+    for (int row = y0; row <= y1; ++row) {
+        CopySpan(row, x0, x1, cells + static_cast<size_t>(row - y) * w + (x0 - x), skipEmpty);
+    }
+    WakeRect(x0 - 1, y0 - 2, x1 + 1, y1 + 1);
+}
+
+void SandSimulation::BlitRegion(int x, int y, int w, int h, const PackedCell* cells) {
+    CopyRegion(x, y, w, h, cells, false);
+}
+
+void SandSimulation::StampRegion(int x, int y, int w, int h, const PackedCell* cells) {
+    CopyRegion(x, y, w, h, cells, true);
+}
+
+// --- Margolus Engine ---
+
+void SandSimulation::UpdateMargolus() {
+    for (size_t i = 0; i < m_blockRects.size(); ++i) {
+        const DirtyRect& rect = m_rects[i];
+        if (!rect.IsEmpty()) m_blockRects[i].Include(rect.minX, rect.minY, rect.maxX, rect.maxY);
+    }
+
+    // Blocks never share cells, so the checkerboard phases only keep neighbouring chunks'
+    // writes and wakes apart
+    if (threadCount > 1) {
+        ForEachChunkPhased(m_blockRects, [this](int chunkIndex, int worker) {
+            m_occupiedDeltas[worker] += UpdateChunkBlocks(chunkIndex);
+        });
+        for (int64_t& delta : m_occupiedDeltas) {
+            m_occupiedCount += delta;
+            delta = 0;
+        }
+        return;
+    }
+    for (size_t i = 0; i < m_blockRects.size(); ++i) {
+        if (!m_blockRects[i].IsEmpty()) m_occupiedCount += UpdateChunkBlocks(static_cast<int>(i));
+    }
+}
+
+int64_t SandSimulation::UpdateChunkBlocks(int chunkIndex) {
+    const DirtyRect& rect = m_blockRects[chunkIndex];
+    const int offset = static_cast<int>(m_tickCount & 1);
+    const bool lateralFlow = !IsHydrostatic();
+
+    // First block corner at or after `lo` on this tick's offset. A change wakes one cell
+    // up and left of itself, so every block holding a woken cell has its corner inside a
+    // rect; blocks hanging off the top or left edge start at -1.
+    auto firstCorner = [offset](int lo) { return lo == 0 ? -offset : lo + ((lo - offset) & 1); };
+
+    int64_t occupiedDelta = 0;
+    for (int by = firstCorner(rect.minY); by <= rect.maxY; by += 2) {
+        for (int bx = firstCorner(rect.minX); bx <= rect.maxX; bx += 2) {
+            occupiedDelta += UpdateBlock(bx, by, lateralFlow);
+        }
+    }
+    return occupiedDelta;
+}
+
+int SandSimulation::UpdateBlock(int bx, int by, bool lateralFlow) {
+    margolus::Block block;
+    block.onFloor = by + 1 == height - 1;
+    size_t indices[4] = {};
+    bool inside = bx >= 0 && by >= 0 && bx + 1 < width && by + 1 < height;
+    bool empty = true;
+    for (int i = 0; i < 4; ++i) {
+        int x = bx + (i & 1);
+        int y = by + (i >> 1);
+        if (!inside && !IsInBounds(x, y)) {
+            block.walls |= 1 << i;
+            continue;
+        }
+        indices[i] = GetIndex(x, y);
+        block.cells[i] = m_grid.Load(indices[i]);
+        empty = empty && block.cells[i].type == MaterialType::Empty;
+    }
+    if (empty) return 0;
+
+    margolus::Block before = block;
+    if (!margolus::UpdateBlock(block, lateralFlow)) return 0;
+
+    int occupiedDelta = 0;
+    for (int i = 0; i < 4; ++i) {
+        const Cell& was = before.cells[i];
+        const Cell& now = block.cells[i];
+        if (((block.walls >> i) & 1) || (was.type == now.type && was.soak == now.soak)) continue;
+        m_grid.Store(indices[i], now);
+        const int delta = (now.type != MaterialType::Empty) - (was.type != MaterialType::Empty);
+        if (delta != 0) MarkOccupied(bx + (i & 1), by + (i >> 1), delta > 0);
+        occupiedDelta += delta;
+    }
+    WakeRect(bx - 1, by - 2, bx + 2, by + 2);
+    return occupiedDelta;
+}
+
+// --- Heightfield ---
+
+void SandSimulation::UpdateHeightfield() {
+    if (!UsesHeightfield()) {
+        for (int x = 0; x < width; ++x) {
+            if (m_bedTops[x] < height) ExpandColumn(x);
+        }
+        return;
+    }
+
+    // Whatever changes a bed or the cells around it wakes the bed's own chunk, so columns
+    // under sleeping chunk columns are left alone and an idle world costs O(chunks)
+    m_awakeChunkColumns.assign(m_chunksX, 0);
+    for (int cy = 0; cy < m_chunksY; ++cy) {
+        for (int cx = 0; cx < m_chunksX; ++cx) {
+            if (!m_rects[cy * m_chunksX + cx].IsEmpty()) m_awakeChunkColumns[cx] = 1;
+        }
+    }
+    if (m_bedColumns > 0) UpdateBeds();
+
+    // Bed cells cannot move under the cell rules, so a column may collapse whatever is
+    // going on above it. One that fails is not read again until its chunk column wakes.
+    if (m_tickCount % BED_COLLAPSE_INTERVAL_TICKS != 0) return;
+    for (int x = 0; x < width; ++x) {
+        if (m_bedTops[x] < height) continue;
+        if ((m_bedFlags[x] & BED_TRIED) && !m_awakeChunkColumns[x >> CHUNK_SHIFT]) continue;
+        if (TryCollapseColumn(x)) m_bedFlags[x] &= ~BED_TRIED;
+        else m_bedFlags[x] |= BED_TRIED;
+    }
+}
+
+void SandSimulation::UpdateBeds() {
+    auto supports = [this](int n, int y) { return n < 0 || n >= width || GetType(n, y) != MaterialType::Empty; };
+    // A grain coming to rest on a bed, or the cells beside it filling in, wakes the cell
+    // above the bed
+    auto isAwake = [this](int x, int y) {
+        const DirtyRect& rect = m_rects[(y >> CHUNK_SHIFT) * m_chunksX + (x >> CHUNK_SHIFT)];
+        return !rect.IsEmpty() && x >= rect.minX && x <= rect.maxX && y >= rect.minY && y <= rect.maxY;
+    };
+
+    for (int cx = 0; cx < m_chunksX; ++cx) {
+        if (!m_awakeChunkColumns[cx]) continue;
+        const int last = std::min((cx + 1) << CHUNK_SHIFT, width) - 1;
+        for (int x = cx << CHUNK_SHIFT; x <= last; ++x) {
+            int& top = m_bedTops[x];
+            if (top == height) continue;
+
+            // Beds written by anyone but the avalanche go back to cells
+            if (m_bedFlags[x] & BED_DISTURBED) {
+                m_bedFlags[x] &= ~BED_DISTURBED;
+                ExpandColumn(x);
+                continue;
+            }
+
+            // Dry sand that has come to rest on a bed joins it, and a bed whose expanded
+            // neighbour no longer holds it up goes back to cells
+            while (top > 0 && isAwake(x, top - 1) && GetType(x, top - 1) == MaterialType::Sand &&
+                   supports(x - 1, top) && supports(x + 1, top)) {
+                --top;
+            }
+            if ((x > 0 && m_bedTops[x - 1] == height && !IsBedSupported(x, x - 1)) ||
+                (x + 1 < width && m_bedTops[x + 1] == height && !IsBedSupported(x, x + 1))) {
+                ExpandColumn(x);
+            }
+        }
+    }
+
+    // Alternating the sweep keeps slides from favouring one side
+    auto avalanche = [this](int x) {
+        if (m_awakeChunkColumns[x >> CHUNK_SHIFT] || m_awakeChunkColumns[(x + 1) >> CHUNK_SHIFT]) AvalanchePair(x, x + 1);
+    };
+    if ((m_tickCount & 1) == 0) {
+        for (int x = 0; x + 1 < width; ++x) avalanche(x);
+    } else {
+        for (int x = width - 2; x >= 0; --x) avalanche(x);
+    }
+}
+
+bool SandSimulation::TryCollapseColumn(int x) {
+    int top = height;
+    while (top > 0 && GetType(x, top - 1) == MaterialType::Sand) --top;
+
+    // Every bed cell needs both cells diagonally below it occupied, as a settled grain does
+    for (int n : { x - 1, x + 1 }) {
+        if (n < 0 || n >= width) continue;
+        int support = m_bedTops[n];
+        while (support > 0 && GetType(n, support - 1) != MaterialType::Empty) --support;
+        top = std::max(top, support - 1);
+    }
+    if (height - top < BED_MIN_ROWS) return false;
+
+    m_bedTops[x] = top;
+    ++m_bedColumns;
+    return true;
+}
+
+void SandSimulation::ExpandColumn(int x) {
+    // Bed cells are held up from below and beside, so only the surface and any face left
+    // by an unfinished avalanche can move; whatever disturbed the bed woke its own cells
+    const int top = m_bedTops[x];
+    int face = top;
+    if (x > 0 && m_bedTops[x - 1] < height) face = std::max(face, m_bedTops[x - 1]);
+    if (x + 1 < width && m_bedTops[x + 1] < height) face = std::max(face, m_bedTops[x + 1]);
+    m_bedTops[x] = height;
+    m_bedFlags[x] &= ~BED_TRIED;
+    --m_bedColumns;
+    WakeRect(x - 1, top - 2, x + 1, face + 1);
+}
+
+void SandSimulation::ExportBeds(std::vector<int32_t>& tops, std::vector<uint8_t>& flags) const {
+    tops.assign(m_bedTops.begin(), m_bedTops.end());
+    flags = m_bedFlags;
+}
+
+void SandSimulation::LoadBeds(const std::vector<int32_t>& tops, const std::vector<uint8_t>& flags) {
+    m_bedTops.assign(tops.begin(), tops.end());
+    m_bedFlags.resize(flags.size());
+    std::transform(flags.begin(), flags.end(), m_bedFlags.begin(), [](uint8_t f) { return f & (BED_DISTURBED | BED_TRIED); });
+    m_bedColumns = static_cast<int>(std::count_if(tops.begin(), tops.end(), [this](int32_t top) { return top < height; }));
+}
+
+bool SandSimulation::IsBedSupported(int x, int n) const {
+    // Cells only change where they are woken, so only awake rows of n are read
+    const int first = m_bedTops[x] + 1;
+    const int cx = n >> CHUNK_SHIFT;
+    for (int cy = first >> CHUNK_SHIFT; cy < m_chunksY; ++cy) {
+        const DirtyRect& rect = m_rects[cy * m_chunksX + cx];
+        if (rect.IsEmpty() || n < rect.minX || n > rect.maxX) continue;
+        for (int y = std::max(rect.minY, first); y <= rect.maxY; ++y) {
+            if (GetType(n, y) == MaterialType::Empty) return false;
+        }
+    }
+    return true;
+}
+
+void SandSimulation::AvalanchePair(int x, int n) {
+    if (m_bedTops[x] == height || m_bedTops[n] == height) return;
+    int from = m_bedTops[x] < m_bedTops[n] ? x : n;
+    int to = from == x ? n : x;
+    int excess = m_bedTops[to] - m_bedTops[from];
+    if (excess < 2) return;
+
+    // Each grain leaves the top of the taller bed and lands on the shorter one, the path
+    // a sliding grain would take over a few ticks
+    const int fromTop = m_bedTops[from];
+    const int toTop = m_bedTops[to];
+    for (int moved = 0; moved < excess / 2; ++moved) {
+        int target = m_bedTops[to] - 1;
+        if (GetType(to, target) != MaterialType::Empty) break;
+        m_grid.Move(GetIndex(from, m_bedTops[from]), GetIndex(to, target));
+        MoveOccupancy(from, m_bedTops[from], to, target);
+        ++m_bedTops[from];
+        --m_bedTops[to];
+    }
+    if (m_bedTops[from] != fromTop) {
+        WakeRect(std::min(x, n) - 1, std::min(fromTop, m_bedTops[to]) - 2, std::max(x, n) + 1, toTop + 1);
+    }
+}
+
+// --- Multi-Resolution ---
+
+void SandSimulation::RouteCoarseChunks() {
+    int focusX = static_cast<int>(std::floor(static_cast<float>(refineFocus.x) / CHUNK_SIZE));
+    int focusY = static_cast<int>(std::floor(static_cast<float>(refineFocus.y) / CHUNK_SIZE));
+
+    for (int cy = 0; cy < m_chunksY; ++cy) {
+        for (int cx = 0; cx < m_chunksX; ++cx) {
+            int chunk = cy * m_chunksX + cx;
+            bool fine = !multiResolution || (std::abs(cx - focusX) <= refineRadius && std::abs(cy - focusY) <= refineRadius);
+            DirtyRect& pending = m_coarseRects[chunk];
+
+            if (!m_coarse[chunk]) {
+                // Far chunks start coarse; after that, a chunk the tool has left turns
+                // coarse once it settles. Its blocks are packed when it is next woken.
+                bool settled = m_rects[chunk].IsEmpty() && (engine != UpdateEngine::Margolus || m_blockRects[chunk].IsEmpty());
+                if (fine || !(settled || !m_coarseSeeded)) continue;
+                m_coarse[chunk] = 1;
+                ++m_coarseChunkCount;
+            } else if (fine) {
+                // The cells are all there, so refining only hands pending work to the fine
+                // engines; the worklist reads none of the rects, so it gets the cells too
+                m_coarse[chunk] = 0;
+                --m_coarseChunkCount;
+                if (!pending.IsEmpty()) {
+                    m_rects[chunk].Include(pending.minX, pending.minY, pending.maxX, pending.maxY);
+                    if (m_sparseActive) QueueRect(pending.minX, pending.minY, pending.maxX, pending.maxY);
+                }
+                pending = DirtyRect{};
+                continue;
+            }
+
+            const DirtyRect& rect = m_rects[chunk];
+            if (!rect.IsEmpty()) pending.Include(rect.minX, rect.minY, rect.maxX, rect.maxY);
+            m_rects[chunk] = DirtyRect{};
+            m_blockRects[chunk] = DirtyRect{};
+        }
+    }
+    m_coarseSeeded = multiResolution;
+}
+
+void SandSimulation::UpdateCoarse() {
+    // Blocks reach one block into neighbouring chunks, which the checkerboard phases keep
+    // apart. Phased even on one thread, so the result does not depend on the thread count.
+    ForEachChunkPhased(m_coarseRects, [this](int chunkIndex, int worker) {
+        m_occupiedDeltas[worker] += UpdateCoarseChunk(chunkIndex);
+    });
+    for (int64_t& delta : m_occupiedDeltas) {
+        m_occupiedCount += delta;
+        delta = 0;
+    }
+    std::fill(m_coarseRects.begin(), m_coarseRects.end(), DirtyRect{});
+}
+
+int64_t SandSimulation::UpdateCoarseChunk(int chunkIndex) {
+    const DirtyRect& rect = m_coarseRects[chunkIndex];
+    const int bx0 = rect.minX >> COARSE_BLOCK_SHIFT;
+    const int bx1 = rect.maxX >> COARSE_BLOCK_SHIFT;
+    const bool leftToRight = ((m_tickCount / COARSE_TICKS) & 1) == 0;
+
+    // Bottom-up like the fine scan, alternating direction so nothing drifts one way
+    int64_t occupiedDelta = 0;
+    for (int by = rect.maxY >> COARSE_BLOCK_SHIFT; by >= rect.minY >> COARSE_BLOCK_SHIFT; --by) {
+        for (int i = 0; i <= bx1 - bx0; ++i) occupiedDelta += UpdateCoarseBlock(leftToRight ? bx0 + i : bx1 - i, by);
+    }
+    return occupiedDelta;
+}
+
+int SandSimulation::UpdateCoarseBlock(int bx, int by) {
+    BlockCounts here = CountBlock(bx, by);
+    if (here.occupied == 0) return 0;
+
+    const int blocksX = (width + COARSE_BLOCK_SIZE - 1) >> COARSE_BLOCK_SHIFT;
+    const int blocksY = (height + COARSE_BLOCK_SIZE - 1) >> COARSE_BLOCK_SHIFT;
+    int occupiedDelta = WetBlock(bx, by);
+    bool changed = occupiedDelta != 0;
+
+    // Heaviest cells fall into the block below first, then sink through its liquid
+    bool onFloor = by + 1 >= blocksY;
+    bool supported = onFloor;
+    if (!onFloor) {
+        int room = CountBlock(bx, by + 1).empty;
+        int fell = MoveBlockCells(bx, by, bx, by + 1, COARSE_SOLID_MASK, room);
+        fell += MoveBlockCells(bx, by, bx, by + 1, COARSE_LIQUID_MASK, room - fell);
+        int sank = SinkBlockCells(bx, by);
+        changed = changed || fell > 0 || sank > 0;
+        supported = fell == room;
+    }
+
+    // Powders and liquids resting on a full block slide into the blocks diagonally below
+    if (supported && !onFloor) {
+        int first = CoinFlip(bx, by) ? 1 : -1;
+        for (int side : { first, -first }) {
+            int sx = bx + side;
+            if (sx < 0 || sx >= blocksX) continue;
+            changed = MoveBlockCells(bx, by, sx, by + 1, COARSE_SLIDE_MASK, CountBlock(sx, by + 1).empty) > 0 || changed;
+        }
+    }
+
+    // Liquid spreads sideways, half the difference in fill at a time
+    here = CountBlock(bx, by);
+    if (supported && here.liquid > 0) {
+        int first = CoinFlip(bx, by + 1) ? 1 : -1;
+        for (int side : { first, -first }) {
+            int sx = bx + side;
+            if (sx < 0 || sx >= blocksX) continue;
+            int excess = (here.occupied - CountBlock(sx, by).occupied) / 2;
+            int flowed = MoveBlockCells(bx, by, sx, by, COARSE_LIQUID_MASK, std::min(excess, here.liquid));
+            here.occupied -= flowed;
+            here.liquid -= flowed;
+            changed = changed || flowed > 0;
+        }
+    }
+
+    changed = PackBlock(bx, by) || changed;
+    if (changed) {
+        // Any neighbouring block may now move, including the ones that took cells
+        int x0 = bx << COARSE_BLOCK_SHIFT;
+        int y0 = by << COARSE_BLOCK_SHIFT;
+        WakeRect(x0 - COARSE_BLOCK_SIZE, y0 - COARSE_BLOCK_SIZE, x0 + 2 * COARSE_BLOCK_SIZE - 1, y0 + 2 * COARSE_BLOCK_SIZE - 1);
+    }
+    return occupiedDelta;
+}
+
+SandSimulation::BlockCounts SandSimulation::CountBlock(int bx, int by) const {
+    BlockCounts counts;
+    int x0 = bx << COARSE_BLOCK_SHIFT;
+    int y0 = by << COARSE_BLOCK_SHIFT;
+    int x1 = std::min(x0 + COARSE_BLOCK_SIZE, width);
+    int y1 = std::min(y0 + COARSE_BLOCK_SIZE, height);
+    for (int y = std::max(y0, 0); y < y1; ++y) {
+        for (int x = std::max(x0, 0); x < x1; ++x) {
+            MaterialType type = m_grid.Type(GetIndex(x, y));
+            if (type == MaterialType::Empty) {
+                ++counts.empty;
+            } else {
+                ++counts.occupied;
+                counts.liquid += (COARSE_LIQUID_MASK >> static_cast<int>(type)) & 1;
+            }
+        }
+    }
+    return counts;
+}
+
+int SandSimulation::MoveBlockCells(int fromX, int fromY, int toX, int toY, uint32_t typeMask, int limit) {
+    if (limit <= 0) return 0;
+
+    // The topmost matching cells go to the lowest empty cells of the target, left to right
+    const int sx0 = fromX << COARSE_BLOCK_SHIFT;
+    const int sx1 = std::min(sx0 + COARSE_BLOCK_SIZE, width) - 1;
+    const int sy0 = fromY << COARSE_BLOCK_SHIFT;
+    const int sy1 = std::min(sy0 + COARSE_BLOCK_SIZE, height) - 1;
+    const int tx0 = toX << COARSE_BLOCK_SHIFT;
+    const int tx1 = std::min(tx0 + COARSE_BLOCK_SIZE, width) - 1;
+    const int ty0 = toY << COARSE_BLOCK_SHIFT;
+    int tx = tx0;
+    int ty = std::min(ty0 + COARSE_BLOCK_SIZE, height) - 1;
+
+    int moved = 0;
+    for (int y = sy0; y <= sy1; ++y) {
+        for (int x = sx0; x <= sx1; ++x) {
+            size_t from = GetIndex(x, y);
+            if (!((typeMask >> static_cast<int>(m_grid.Type(from))) & 1)) continue;
+
+            while (ty >= ty0 && m_grid.Type(GetIndex(tx, ty)) != MaterialType::Empty) {
+                if (tx < tx1) {
+                    ++tx;
+                } else {
+                    tx = tx0;
+                    --ty;
+                }
+            }
+            if (ty < ty0) return moved;
+
+            size_t to = GetIndex(tx, ty);
+            m_grid.Move(from, to);
+            m_stamps[to] = m_tick;
+            MoveOccupancy(x, y, tx, ty);
+            if (++moved == limit) return moved;
+        }
+    }
+    return moved;
+}
+
+int SandSimulation::SinkBlockCells(int bx, int by) {
+    // Lowest cells of this block trade places with the topmost lighter liquid below it
+    const int x0 = bx << COARSE_BLOCK_SHIFT;
+    const int x1 = std::min(x0 + COARSE_BLOCK_SIZE, width) - 1;
+    const int y0 = by << COARSE_BLOCK_SHIFT;
+    const int y1 = std::min(y0 + COARSE_BLOCK_SIZE, height) - 1;
+    const int belowY0 = y1 + 1;
+    const int belowY1 = std::min(belowY0 + COARSE_BLOCK_SIZE, height) - 1;
+
+    int sank = 0;
+    for (int y = y1; y >= y0; --y) {
+        for (int x = x0; x <= x1; ++x) {
+            size_t upper = GetIndex(x, y);
+            uint32_t sinkMask = SINK_MASKS[static_cast<int>(m_grid.Type(upper))];
+            if (sinkMask == 0) continue;
+
+            for (int ly = belowY0; ly <= belowY1 && sinkMask != 0; ++ly) {
+                for (int lx = x0; lx <= x1; ++lx) {
+                    size_t lower = GetIndex(lx, ly);
+                    if (!((sinkMask >> static_cast<int>(m_grid.Type(lower))) & 1)) continue;
+                    m_grid.Swap(upper, lower);
+                    m_stamps[upper] = m_tick;
+                    m_stamps[lower] = m_tick;
+                    SwapOccupancy(x, y, lx, ly);
+                    ++sank;
+                    sinkMask = 0;
+                    break;
+                }
+            }
+        }
+    }
+    return sank;
+}
+
+int SandSimulation::WetBlock(int bx, int by) {
+    // Wetting liquid soaks into absorbent cells of its own block or the one below, and
+    // is used up
+    const int x0 = bx << COARSE_BLOCK_SHIFT;
+    const int x1 = std::min(x0 + COARSE_BLOCK_SIZE, width) - 1;
+    const int y0 = by << COARSE_BLOCK_SHIFT;
+    const int y1 = std::min(y0 + COARSE_BLOCK_SIZE, height) - 1;
+    const int reachY = std::min(y1 + COARSE_BLOCK_SIZE, height - 1);
+
+    int occupiedDelta = 0;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            size_t source = GetIndex(x, y);
+            if (!GetMaterial(m_grid.Type(source)).wets) continue;
+
+            for (int ty = reachY; ty >= y0; --ty) {
+                bool soaked = false;
+                for (int tx = x0; tx <= x1 && !soaked; ++tx) {
+                    size_t target = GetIndex(tx, ty);
+                    Cell cell = m_grid.Load(target);
+                    const MaterialDesc& desc = GetMaterial(cell.type);
+                    if (desc.wetForm == MaterialType::Empty || cell.soak >= desc.maxSoak) continue;
+
+                    m_grid.Store(target, { desc.wetForm, cell.soak + 1 });
+                    m_grid.Store(source, Cell{});
+                    MarkOccupied(x, y, false);
+                    --occupiedDelta;
+                    soaked = true;
+                }
+                if (soaked) break;
+            }
+        }
+    }
+    return occupiedDelta;
+}
+
+bool SandSimulation::PackBlock(int bx, int by) {
+    // Heaviest at the bottom, keeping each cell's soak; empty cells rise to the top
+    const int x0 = bx << COARSE_BLOCK_SHIFT;
+    const int x1 = std::min(x0 + COARSE_BLOCK_SIZE, width) - 1;
+    const int y0 = by << COARSE_BLOCK_SHIFT;
+    const int y1 = std::min(y0 + COARSE_BLOCK_SIZE, height) - 1;
+
+    Cell cells[COARSE_BLOCK_SIZE * COARSE_BLOCK_SIZE];
+    int count = 0;
+    for (int y = y1; y >= y0; --y) {
+        for (int x = x0; x <= x1; ++x) cells[count++] = m_grid.Load(GetIndex(x, y));
+    }
+    Cell packed[COARSE_BLOCK_SIZE * COARSE_BLOCK_SIZE];
+    std::copy(cells, cells + count, packed);
+    std::stable_sort(packed, packed + count, [](const Cell& a, const Cell& b) {
+        return GetMaterial(a.type).density > GetMaterial(b.type).density;
+    });
+
+    bool changed = false;
+    int i = 0;
+    for (int y = y1; y >= y0; --y) {
+        for (int x = x0; x <= x1; ++x, ++i) {
+            if (packed[i].type == cells[i].type && packed[i].soak == cells[i].soak) continue;
+            m_grid.Store(GetIndex(x, y), packed[i]);
+            MarkOccupied(x, y, packed[i].type != MaterialType::Empty);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// --- Hydrostatic Water ---
+
+int SandSimulation::FindWaterBody(int run) {
+    while (m_runParent[run] != run) {
+        m_runParent[run] = m_runParent[m_runParent[run]];
+        run = m_runParent[run];
+    }
+    return run;
+}
+
+bool SandSimulation::IsWaterAwake() const {
+    // A write wakes its neighbours, so a change that touches a body, or an opening beside
+    // one, leaves some of the body's water inside a rect
+    for (const std::vector<DirtyRect>* rects : { &m_rects, &m_nextRects, &m_coarseRects }) {
+        for (const DirtyRect& rect : *rects) {
+            if (rect.IsEmpty()) continue;
+            for (int y = rect.minY; y <= rect.maxY; ++y) {
+                for (int x = NextOccupied(rect.minX, y, rect.maxX); x <= rect.maxX; x = NextOccupied(x + 1, y, rect.maxX)) {
+                    if (m_grid.Type(GetIndex(x, y)) == MaterialType::Water) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void SandSimulation::LevelWater() {
+    m_waterRuns.clear();
+    m_runParent.clear();
+
+    // Runs come from the same row bit-planes as the bitboard engine, so dry rows cost a
+    // few word tests
+    const int words = bitboard::WordCount(width);
+    m_planes.resize(std::max(m_planes.size(), static_cast<size_t>(words)));
+    uint64_t* water = m_planes.data();
+    auto nextBit = [water, words, this](int from, bool set) {
+        for (int w = from / bitboard::WORD_BITS; w < words; ++w) {
+            uint64_t bits = set ? water[w] : ~water[w];
+            if (w == from / bitboard::WORD_BITS) bits &= ~0ull << (from % bitboard::WORD_BITS);
+            if (bits != 0) return std::min(width, w * bitboard::WORD_BITS + __builtin_ctzll(bits));
+        }
+        return width;
+    };
+
+    // Each row's runs join the runs they overlap in the row above; both rows are sorted by x
+    size_t aboveBegin = 0;
+    size_t aboveEnd = 0;
+    for (int y = 0; y < height; ++y) {
+        size_t rowBegin = m_waterRuns.size();
+        size_t above = aboveBegin;
+        BuildRowMask(y, MaterialType::Water, water);
+        for (int x0 = nextBit(0, true); x0 < width; x0 = nextBit(x0, true)) {
+            int x = nextBit(x0, false) - 1;
+            int run = static_cast<int>(m_waterRuns.size());
+            m_waterRuns.push_back(WaterRun{ y, x0, x });
+            m_runParent.push_back(run);
+
+            while (above < aboveEnd && m_waterRuns[above].x1 < x0) ++above;
+            for (size_t a = above; a < aboveEnd && m_waterRuns[a].x0 <= x; ++a) {
+                int rootA = FindWaterBody(static_cast<int>(a));
+                int rootB = FindWaterBody(run);
+                if (rootA != rootB) m_runParent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+            }
+            x0 = x + 1;
+        }
+        aboveBegin = rowBegin;
+        aboveEnd = m_waterRuns.size();
+    }
+
+    // Surface cells have no water above them; openings are empty cells next to a body
+    auto isEmpty = [this](int x, int y) {
+        return IsInBounds(x, y) && m_grid.Type(GetIndex(x, y)) == MaterialType::Empty;
+    };
+    m_surfaceCells.clear();
+    m_openings.clear();
+    for (size_t i = 0; i < m_waterRuns.size(); ++i) {
+        const WaterRun& run = m_waterRuns[i];
+        int body = FindWaterBody(static_cast<int>(i));
+        if (isEmpty(run.x0 - 1, run.y)) m_openings.push_back(LevelCell{ body, run.y, run.x0 - 1 });
+        if (isEmpty(run.x1 + 1, run.y)) m_openings.push_back(LevelCell{ body, run.y, run.x1 + 1 });
+        for (int x = run.x0; x <= run.x1; ++x) {
+            if (run.y == 0 || m_grid.Type(GetIndex(x, run.y - 1)) != MaterialType::Water) {
+                m_surfaceCells.push_back(LevelCell{ body, run.y, x });
+            }
+            if (isEmpty(x, run.y - 1)) m_openings.push_back(LevelCell{ body, run.y - 1, x });
+            if (isEmpty(x, run.y + 1)) m_openings.push_back(LevelCell{ body, run.y + 1, x });
+        }
+    }
+
+    std::sort(m_surfaceCells.begin(), m_surfaceCells.end(), [](const LevelCell& a, const LevelCell& b) {
+        return a.body < b.body;
+    });
+    std::sort(m_openings.begin(), m_openings.end(), [](const LevelCell& a, const LevelCell& b) {
+        return a.body < b.body;
+    });
+
+    // Heap orders: the highest surface cell and the lowest opening come first
+    auto lowerFirst = [](const LevelCell& a, const LevelCell& b) { return a.y != b.y ? a.y < b.y : a.x > b.x; };
+    auto higherFirst = [](const LevelCell& a, const LevelCell& b) { return a.y != b.y ? a.y > b.y : a.x > b.x; };
+
+    size_t s = 0;
+    size_t o = 0;
+    while (s < m_surfaceCells.size()) {
+        int body = m_surfaceCells[s].body;
+        size_t sEnd = s;
+        while (sEnd < m_surfaceCells.size() && m_surfaceCells[sEnd].body == body) ++sEnd;
+        while (o < m_openings.size() && m_openings[o].body < body) ++o;
+        size_t oEnd = o;
+        while (oEnd < m_openings.size() && m_openings[oEnd].body == body) ++oEnd;
+
+        m_levelTops.assign(m_surfaceCells.begin() + s, m_surfaceCells.begin() + sEnd);
+        m_levelHoles.assign(m_openings.begin() + o, m_openings.begin() + oEnd);
+        std::make_heap(m_levelTops.begin(), m_levelTops.end(), higherFirst);
+        std::make_heap(m_levelHoles.begin(), m_levelHoles.end(), lowerFirst);
+        s = sEnd;
+        o = oEnd;
+
+        // Every move lowers a cell, so the body levels out instead of oscillating. A filled
+        // opening exposes its empty neighbours and an emptied surface cell the one below,
+        // so a single pass levels the body to within one cell.
+        while (!m_levelTops.empty() && !m_levelHoles.empty()) {
+            LevelCell top = m_levelTops.front();
+            LevelCell hole = m_levelHoles.front();
+            if (top.y >= hole.y) break;
+
+            std::pop_heap(m_levelHoles.begin(), m_levelHoles.end(), lowerFirst);
+            m_levelHoles.pop_back();
+            // Openings can be listed twice, or filled already from another side
+            if (!isEmpty(hole.x, hole.y)) continue;
+
+            std::pop_heap(m_levelTops.begin(), m_levelTops.end(), higherFirst);
+            m_levelTops.pop_back();
+            Set(hole.x, hole.y, MaterialType::Water);
+            Set(top.x, top.y, MaterialType::Empty);
+
+            static const int neighbours[4][2] = {{-1, 0}, {1, 0}, {0, 1}, {0, -1}};
+            for (const auto& n : neighbours) {
+                if (!isEmpty(hole.x + n[0], hole.y + n[1])) continue;
+                m_levelHoles.push_back(LevelCell{ body, hole.y + n[1], hole.x + n[0] });
+                std::push_heap(m_levelHoles.begin(), m_levelHoles.end(), lowerFirst);
+            }
+            if (IsInBounds(top.x, top.y + 1) && m_grid.Type(GetIndex(top.x, top.y + 1)) == MaterialType::Water) {
+                m_levelTops.push_back(LevelCell{ body, top.y + 1, top.x });
+                std::push_heap(m_levelTops.begin(), m_levelTops.end(), higherFirst);
+            }
+        }
+    }
+}
@@ -0,0 +1,657 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "core/cell.h"
+#include "core/cell_storage.h"
+#include "core/material.h"
+#include "core/random.h"
+#include "core/simulation_backend.h"
+
+class WorkerPool;
+
+constexpr int CHUNK_SHIFT = 5;
+constexpr int CHUNK_SIZE = 1 << CHUNK_SHIFT;
+constexpr int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+// Multi-resolution blocks; a chunk is a whole number of them. Material crosses up to a
+// block per coarse tick, so coarse chunks tick once per block width of fine ticks.
+constexpr int COARSE_BLOCK_SHIFT = 2;
+constexpr int COARSE_BLOCK_SIZE = 1 << COARSE_BLOCK_SHIFT;
+constexpr int COARSE_TICKS = COARSE_BLOCK_SIZE;
+
+enum class UpdateEngine {
+    Scan,       // Cell-by-cell rules, serial or checkerboard-parallel
+    Bitboard,   // Whole-row bit-plane kernel for dry sand, scalar rules for the rest
+    Margolus,   // 2x2 block rules on alternating offsets; order-free, so blocks run in parallel
+    Count
+};
+
+// Order of cells in storage. Tiled layouts pad the grid to whole tiles and keep tiles in
+// row-major order.
+enum class GridLayout {
+    RowMajor,   // Contiguous rows; the only layout the bitboard engine runs on
+    Tiled,      // 8x8 tiles, one cache line of packed cells, so disks and neighbours stay local
+    Chunked,    // One tile per chunk, so a chunk shares pages; paged worlds always use it
+    ZOrder,     // Chunk tiles with cells in Morton order inside each chunk
+    Count
+};
+
+constexpr int TILED_SHIFT = 3;
+
+// Which cells the Scan engine visits each tick
+enum class WorklistMode {
+    Auto,       // Sparse below SPARSE_ENTER_FILL occupancy, dense above SPARSE_EXIT_FILL
+    Dense,      // Every cell inside the awake chunk rects
+    Sparse,     // Only occupied cells that were woken last tick
+    Count
+};
+
+// How water finds its level
+enum class WaterMode {
+    Cellular,     // Spreads one cell sideways per tick
+    Hydrostatic,  // Connected bodies move surface cells straight to their lowest openings
+    Count
+};
+
+// Occupied fraction of the grid at which Auto switches modes; the gap avoids flapping
+constexpr float SPARSE_ENTER_FILL = 0.015f;
+constexpr float SPARSE_EXIT_FILL = 0.03f;
+
+// Inclusive cell-space rectangle, empty while minX > maxX
+struct DirtyRect {
+    int minX = 0;
+    int minY = 0;
+    int maxX = -1;
+    int maxY = -1;
+
+    [[nodiscard]] bool IsEmpty() const { return minX > maxX; }
+
+    void Include(int x0, int y0, int x1, int y1) {
+        if (IsEmpty()) {
+            minX = x0; minY = y0; maxX = x1; maxY = y1;
+            return;
+        }
+        minX = std::min(minX, x0);
+        minY = std::min(minY, y0);
+        maxX = std::max(maxX, x1);
+        maxY = std::max(maxY, y1);
+    }
+};
+
+// --- Sand Simulation ---
+class SandSimulation final : public SimulationBackend {
+private:
+    CellStorage m_grid;
+    Cell m_boundaryCell = { MaterialType::Sand, 0 };
+
+    // Chunk sleeping: only cells inside a chunk's dirty rect are visited by Update().
+    // Changes made during a tick accumulate in m_nextRects and become active next tick.
+    int m_chunksX = 0;
+    int m_chunksY = 0;
+    std::vector<DirtyRect> m_rects;
+    std::vector<DirtyRect> m_nextRects;
+
+    // Margolus engine: a block that stays put under one offset may still move under the
+    // other, so a change keeps its neighbourhood awake for two ticks. Each tick's blocks
+    // come from this tick's and last tick's rects merged.
+    std::vector<DirtyRect> m_blockRects;
+
+    // Cells moved during the current tick carry the tick stamp so the scan skips them
+    CellBuffer<uint8_t> m_stamps;
+    uint8_t m_tick = 0;
+
+    // Full tick counter, part of every random draw's key
+    uint64_t m_tickCount = 0;
+
+    // High-rate region: its cells are stamped at the start of every full tick so the scan
+    // leaves them to UpdateRegion(). Region sub-ticks since the last full tick go into
+    // the draw key, so no two sub-ticks, or a sub-tick and a full tick, share draws.
+    DirtyRect m_region;
+    uint32_t m_regionTick = 0;
+
+    // Phased engine: same-coloured chunks of a 2x2 checkerboard are at least one chunk
+    // apart, so they can update concurrently. Wakes that reach into other chunks are
+    // queued per worker and merged between phases. One thread runs the same phases, so
+    // the result does not depend on the thread count.
+    std::unique_ptr<WorkerPool> m_pool;
+    std::vector<std::vector<DirtyRect>> m_wakeQueues;
+    std::vector<int> m_phaseChunks;
+    std::vector<int64_t> m_occupiedDeltas;
+    bool m_inParallelPhase = false;
+
+    // Phase of the fine scan in progress, NO_PASS outside it. A wake into a chunk the scan
+    // has yet to reach also widens that chunk's current rect, so the cells are updated in
+    // this pass exactly as a full scan would reach them.
+    static constexpr int NO_PASS = 4;
+    int m_passPhase = NO_PASS;
+
+    // Sparse worklist: occupied cells woken last tick, keyed in scan order so sorting the
+    // list gives the same order as the phased full scan. Cells woken ahead of the cursor
+    // join the current pass through m_passHeap, as the dense scan picks them up too. Chunk
+    // rects are kept up to date in both modes so switching back to dense needs no rebuild.
+    static constexpr uint8_t QUEUED_NEXT = 0x1;
+    static constexpr uint8_t QUEUED_PASS = 0x2;
+    bool m_sparseActive = false;
+    std::vector<int64_t> m_active;
+    std::vector<int64_t> m_nextActive;
+    std::vector<int64_t> m_passHeap;
+    CellBuffer<uint8_t> m_queued;
+    int64_t m_passCursor = INT64_MAX;
+    int64_t m_occupiedCount = 0;
+
+    // Storage layout. Every layout's index splits into a part that depends only on y and
+    // one that depends only on x, so GetIndex is two table loads and an add whatever the
+    // layout; that matches row-major's multiply-add in the update loops. Stamps and queue
+    // marks share the grid's indexing.
+    GridLayout m_layout = GridLayout::RowMajor;
+    size_t m_storageCellCount = 0;
+    std::vector<size_t> m_rowOffsets;
+    std::vector<size_t> m_colOffsets;
+
+    // Paged world: cells live in a memory-mapped file in the chunked layout, so a chunk's
+    // cells share pages. The occupancy bitmaps follow them in the same file. Every releaseIntervalTicks the pages of chunks that are asleep
+    // and away from pagingFocus are handed back to the kernel.
+    bool m_paged = false;
+
+    // Hydrostatic water: horizontal runs of water cells joined into bodies by union-find.
+    // Leveling is pending once an awake rect holds water and runs every
+    // waterLevelIntervalTicks, so grains moving away from any water cost nothing extra.
+    struct WaterRun {
+        int y;
+        int x0;
+        int x1;
+    };
+    struct LevelCell {
+        int body;
+        int y;
+        int x;
+    };
+    std::vector<WaterRun> m_waterRuns;
+    std::vector<int> m_runParent;
+    std::vector<LevelCell> m_surfaceCells;
+    std::vector<LevelCell> m_openings;
+    std::vector<LevelCell> m_levelTops;
+    std::vector<LevelCell> m_levelHoles;
+    bool m_levelPending = false;
+
+    // Multi-resolution: chunks marked in m_coarse skip the fine engines. Their woken rects
+    // collect in m_coarseRects and run as 4x4 blocks every COARSE_TICKS ticks. Cells stay
+    // the only copy of the world, kept packed heaviest-first from the bottom of each
+    // block, so a coarse block is described by its counts alone and refining is free.
+    std::vector<uint8_t> m_coarse;
+    std::vector<DirtyRect> m_coarseRects;
+    int m_coarseChunkCount = 0;
+    bool m_coarseSeeded = false;  // Far chunks have been made coarse since multi-resolution came on
+
+    // Heightfield: the bottom rows of column x from m_bedTops[x] down are a bed of settled
+    // dry sand. The scan skips bed cells and UpdateHeightfield moves beds by their heights
+    // alone; m_bedTops[x] == height means no bed. Cells stay the only copy of the world and
+    // everything above a bed is simulated as usual.
+    static constexpr uint8_t BED_DISTURBED = 0x1;  // A bed cell was written; expands next tick
+    static constexpr uint8_t BED_TRIED = 0x2;      // Failed to collapse; retried once woken
+    std::vector<int> m_bedTops;
+    std::vector<uint8_t> m_bedFlags;
+    int m_bedColumns = 0;
+    std::vector<uint8_t> m_awakeChunkColumns;
+
+    // Checkpoints: chunks that may have been written since the last TakeEditedChunks().
+    // Every write wakes its own cell, so a chunk whose next rect was ever non-empty is
+    // flagged; the rects are folded in before each tick clears them.
+    std::vector<uint8_t> m_editedChunks;
+
+    // Row bit-plane scratch for the bitboard engine and water leveling
+    std::vector<uint64_t> m_planes;
+
+    // Occupancy: bit x % 64 of word x / 64 of row y is set while cell (x, y) is not
+    // Empty, in the bitboard kernel's word layout. Every write keeps it exact, so scans and
+    // queries step over empty runs a word at a time. Chunks of one parallel phase can both
+    // write the chunk between them, whose cells share words, so writes in a phase are
+    // atomic; reads are relaxed atomic loads, which cost nothing over plain ones.
+    // Rows come in bands of 1 << m_occupancyBandShift, stored word column by word column.
+    // Heap worlds use bands of one row, so each row's words are contiguous. Paged worlds
+    // use a chunk's height, so a chunk's bits share pages with its neighbours' rather than
+    // with the whole width. They are paged out with it and are still exact when the file
+    // is reopened.
+    static constexpr int OCCUPANCY_SHIFT = 6;
+    static constexpr int OCCUPANCY_MASK = (1 << OCCUPANCY_SHIFT) - 1;
+    CellBuffer<uint64_t> m_occupancy;
+    int m_occupancyWords = 0;
+    int m_occupancyBandShift = 0;
+
+    [[nodiscard]] bool IsInBounds(int x, int y) const {
+        return x >= 0 && x < width && y >= 0 && y < height;
+    }
+
+    // In-bounds coordinates only
+    [[nodiscard]] size_t GetIndex(int x, int y) const {
+        return m_rowOffsets[y] + m_colOffsets[x];
+    }
+
+    [[nodiscard]] static int GetChunkPhase(int cx, int cy) { return ((cy & 1) << 1) | (cx & 1); }
+
+    // Sparse worklist keys run by checkerboard phase, then bottom-up, then left-to-right.
+    // Chunks of one phase never reach each other's cells, so interleaving their rows
+    // gives the same result as the phased scan taking them one chunk at a time.
+    [[nodiscard]] int64_t GetScanKey(int x, int y) const {
+        const int64_t phase = GetChunkPhase(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+        return (phase * height + (height - 1 - y)) * width + x;
+    }
+
+    [[nodiscard]] size_t GetScanKeyIndex(int64_t key, int& x, int& y) const {
+        y = height - 1 - static_cast<int>((key / width) % height);
+        x = static_cast<int>(key % width);
+        return GetIndex(x, y);
+    }
+
+    // Whether the fine scan in progress still reaches chunk (cx, cy). Workers only take
+    // their own chunk; wakes into later phases reach those through the merge.
+    [[nodiscard]] bool IsAheadOfPass(int cx, int cy) const {
+        const int phase = GetChunkPhase(cx, cy);
+        return m_inParallelPhase ? phase == m_passPhase : phase >= m_passPhase;
+    }
+
+    // Unchecked accessors for the update kernels, which test every neighbour they touch
+    [[nodiscard]] MaterialType GetType(int x, int y) const { return m_grid.Type(GetIndex(x, y)); }
+
+    void MoveToEmpty(int x1, int y1, int x2, int y2) {
+        size_t idx2 = GetIndex(x2, y2);
+        m_grid.Move(GetIndex(x1, y1), idx2);
+        m_stamps[idx2] = m_tick;
+        MoveOccupancy(x1, y1, x2, y2);
+        WakePair(x1, y1, x2, y2);
+    }
+
+    void SwapCells(int x1, int y1, int x2, int y2) {
+        size_t idx1 = GetIndex(x1, y1);
+        size_t idx2 = GetIndex(x2, y2);
+        m_grid.Swap(idx1, idx2);
+        m_stamps[idx1] = m_tick;
+        m_stamps[idx2] = m_tick;
+        SwapOccupancy(x1, y1, x2, y2);
+        WakePair(x1, y1, x2, y2);
+    }
+
+    // --- Occupancy ---
+    [[nodiscard]] size_t GetOccupancyIndex(int x, int y) const {
+        const size_t column = static_cast<size_t>(y >> m_occupancyBandShift) * m_occupancyWords + (x >> OCCUPANCY_SHIFT);
+        return (column << m_occupancyBandShift) + (y & ((1 << m_occupancyBandShift) - 1));
+    }
+
+    [[nodiscard]] static uint64_t LoadOccupancy(const uint64_t& word) { return __atomic_load_n(&word, __ATOMIC_RELAXED); }
+
+    [[nodiscard]] bool IsOccupied(int x, int y) const {
+        return (LoadOccupancy(m_occupancy[GetOccupancyIndex(x, y)]) >> (x & OCCUPANCY_MASK)) & 1;
+    }
+
+    void MarkOccupied(int x, int y, bool occupied) {
+        uint64_t& word = m_occupancy[GetOccupancyIndex(x, y)];
+        const uint64_t bit = 1ull << (x & OCCUPANCY_MASK);
+        if (m_inParallelPhase) {
+            if (occupied) __atomic_fetch_or(&word, bit, __ATOMIC_RELAXED);
+            else __atomic_fetch_and(&word, ~bit, __ATOMIC_RELAXED);
+        } else {
+            word = occupied ? word | bit : word & ~bit;
+        }
+    }
+
+    void MoveOccupancy(int x1, int y1, int x2, int y2) {
+        MarkOccupied(x1, y1, false);
+        MarkOccupied(x2, y2, true);
+    }
+
+    void SwapOccupancy(int x1, int y1, int x2, int y2) {
+        const bool first = IsOccupied(x1, y1);
+        const bool second = IsOccupied(x2, y2);
+        if (first == second) return;
+        MarkOccupied(x1, y1, second);
+        MarkOccupied(x2, y2, first);
+    }
+
+    // First column in x..x1 of row y whose bit, flipped by `invert`, is set, or x1 + 1.
+    // Bits past the row width are zero, so callers looking for empty cells must keep x1
+    // inside the grid.
+    [[nodiscard]] int ScanOccupancy(int x, int y, int x1, uint64_t invert) const {
+        if (x > x1) return x1 + 1;
+        const uint64_t* row = &m_occupancy[GetOccupancyIndex(0, y)];
+        int w = x >> OCCUPANCY_SHIFT;
+        const int last = x1 >> OCCUPANCY_SHIFT;
+        uint64_t bits = (LoadOccupancy(row[static_cast<size_t>(w) << m_occupancyBandShift]) ^ invert) &
+                        (~0ull << (x & OCCUPANCY_MASK));
+        while (bits == 0) {
+            if (++w > last) return x1 + 1;
+            bits = LoadOccupancy(row[static_cast<size_t>(w) << m_occupancyBandShift]) ^ invert;
+        }
+        return std::min((w << OCCUPANCY_SHIFT) + __builtin_ctzll(bits), x1 + 1);
+    }
+
+    [[nodiscard]] int NextOccupied(int x, int y, int x1) const { return ScanOccupancy(x, y, x1, 0); }
+    [[nodiscard]] int NextEmpty(int x, int y, int x1) const { return ScanOccupancy(x, y, x1, ~0ull); }
+
+    // Interior cells read one column either side, one row above and two below (the
+    // wetting probe) without leaving the grid, so their kernels skip the edge tests. The
+    // band of edge cells around them is the only place the kernels check bounds.
+    [[nodiscard]] bool IsInteriorRow(int y) const { return y >= 1 && y < height - 2; }
+
+    [[nodiscard]] size_t GetStorageCellCount() const { return m_storageCellCount; }
+    void SelectLayout(GridLayout layout);
+    void ResetBookkeeping();
+    void AdvanceStamp();
+    void StoreRowMajor(const PackedCell* cells);
+    void NoteEditedChunks();
+    // Workers of a parallel phase add to their own slot, folded in once the phase is over
+    void AddOccupied(int64_t delta);
+    // Writes cells x0..x1 of row y, which must be inside the grid, keeping the occupied
+    // count and beds up to date; callers wake what they wrote
+    void FillSpan(int y, int x0, int x1, const Cell& cell);
+    void CopySpan(int y, int x0, int x1, const PackedCell* cells, bool skipEmpty);
+    void CopyRegion(int x, int y, int w, int h, const PackedCell* cells, bool skipEmpty);
+    // Bulk occupancy updates for the same spans, and a rebuild from the cells after a heap
+    // world's whole grid was replaced
+    void MarkOccupiedSpan(int y, int x0, int x1, bool occupied);
+    void CopyOccupancy(int y, int x0, int x1, const PackedCell* cells, bool skipEmpty);
+    void RebuildOccupancy();
+
+public:
+    int width = INITIAL_WIDTH;
+    int height = INITIAL_HEIGHT;
+    float tickDelayMs = TICK_DELAY_DEFAULT;
+    bool chunkSleeping = true;
+    int threadCount = 1;
+    UpdateEngine engine = UpdateEngine::Scan;
+    WorklistMode worklistMode = WorklistMode::Auto;
+    uint64_t seed = DEFAULT_SEED;
+    WaterMode waterMode = WaterMode::Cellular;
+    int waterLevelIntervalTicks = 1;
+
+    // Paged worlds keep chunks within residentRadius chunks of pagingFocus in memory
+    glm::ivec2 pagingFocus = { 0, 0 };
+    int residentRadius = 8;
+    int releaseIntervalTicks = 64;
+
+    // Multi-resolution keeps chunks within refineRadius chunks of refineFocus fine; the
+    // rest turn coarse once they settle. Displace moves the focus along with the tool.
+    bool multiResolution = false;
+    glm::ivec2 refineFocus = { 0, 0 };
+    int refineRadius = 2;
+
+    explicit SandSimulation(uint64_t initialSeed = DEFAULT_SEED);
+    ~SandSimulation();
+
+    SandSimulation(const SandSimulation&) = delete;
+    SandSimulation& operator=(const SandSimulation&) = delete;
+
+    // Resize keeps the current layout
+    void Resize(int w, int h);
+    void Clear() override;
+
+    // Re-lays out the current cells; paged worlds cannot change layout
+    bool SetLayout(GridLayout layout);
+    [[nodiscard]] GridLayout GetLayout() const { return m_layout; }
+
+    // Backs a w x h world with a memory-mapped file instead of the heap, so it can be
+    // larger than RAM. An existing file of the same dimensions is reopened as is, with
+    // every chunk asleep. Resize() returns to a heap world.
+    bool OpenPagedWorld(const std::string& path, int w, int h);
+    [[nodiscard]] bool IsPaged() const { return m_paged; }
+    // Writes the world header and dirty pages back to the file
+    void SyncPagedWorld();
+    void ReleaseColdChunks();
+
+    // Replaces the world with w x h row-major packed cells, e.g. from a snapshot. Row-major
+    // packed storage adopts the buffer as is, so a mapped file is used in place; other
+    // layouts copy it. Every chunk is woken so the restored world carries on moving. The
+    // occupied count is taken from the cells, not from whoever supplied them.
+    void LoadCells(int w, int h, CellBuffer<PackedCell>&& cells);
+    // Restores the tick counter, which keys every random draw
+    void SetTickCount(uint64_t tickCount) { m_tickCount = tickCount; }
+
+    // Dunes: settled dry-sand columns collapse into beds described by their heights, which
+    // avalanche in O(width) per tick. A bed expands back into cells when something other
+    // than the avalanche writes to it (painting, wetting, the tool digging below its top)
+    // or the cells beside it stop holding it up. Needs the Scan engine; multi-resolution
+    // and paged worlds turn it off.
+    bool heightfield = false;
+    [[nodiscard]] int GetBedColumnCount() const { return m_bedColumns; }
+    // Top row of column x's bed, or height when it has none
+    [[nodiscard]] int GetBedTop(int x) const { return m_bedTops[x]; }
+    // Beds are not in the cells, so saves carry every column's bed top and flags beside
+    // them. LoadBeds goes after LoadCells with what ExportBeds gave for the same cells.
+    void ExportBeds(std::vector<int32_t>& tops, std::vector<uint8_t>& flags) const;
+    void LoadBeds(const std::vector<int32_t>& tops, const std::vector<uint8_t>& flags);
+
+    [[nodiscard]] Cell Get(int x, int y) const {
+        if (!IsInBounds(x, y)) return m_boundaryCell;
+        return m_grid.Load(GetIndex(x, y));
+    }
+
+    void Set(int x, int y, MaterialType type, int soak = 0) {
+        if (IsInBounds(x, y)) {
+            size_t idx = GetIndex(x, y);
+            AddOccupied((type != MaterialType::Empty) - (m_grid.Type(idx) != MaterialType::Empty));
+            m_grid.Store(idx, {type, soak});
+            MarkOccupied(x, y, type != MaterialType::Empty);
+            WakeCell(x, y);
+            NoteBedWrite(x, y);
+        }
+    }
+
+    bool Move(int x1, int y1, int x2, int y2) {
+        if (!IsInBounds(x1, y1) || !IsInBounds(x2, y2)) return false;
+        if (GetType(x2, y2) != MaterialType::Empty) return false;
+        MoveToEmpty(x1, y1, x2, y2);
+        // Taking the top of a bed, e.g. the tool pressing in from above, just lowers it
+        if (m_bedColumns > 0 && y1 == m_bedTops[x1] && !m_inParallelPhase) {
+            if (++m_bedTops[x1] == height) --m_bedColumns;
+        } else {
+            NoteBedWrite(x1, y1);
+        }
+        return true;
+    }
+
+    bool Swap(int x1, int y1, int x2, int y2) {
+        if (!IsInBounds(x1, y1) || !IsInBounds(x2, y2)) return false;
+        SwapCells(x1, y1, x2, y2);
+        NoteBedWrite(x1, y1);
+        NoteBedWrite(x2, y2);
+        return true;
+    }
+
+    // Bulk edits clamp to the grid, write row spans straight into storage (a memset or
+    // memcpy per row in the row-major layout) and wake the region once rather than per
+    // cell. Shapes cover the cells whose coordinates fall inside them, as Displace does.
+    // Rects are inclusive.
+    void FillRect(int x0, int y0, int x1, int y1, MaterialType type, int soak = 0);
+    void ClearRect(int x0, int y0, int x1, int y1) { FillRect(x0, y0, x1, y1, MaterialType::Empty); }
+    void FillCircle(const glm::vec2& center, float radius, MaterialType type, int soak = 0);
+    // Even-odd fill of a closed polygon
+    void FillPolygon(const std::vector<glm::vec2>& points, MaterialType type, int soak = 0);
+    // Every cell within `radius` of the segment from a to b, e.g. a brush stroke between
+    // two mouse samples
+    void FillLine(const glm::vec2& a, const glm::vec2& b, float radius, MaterialType type, int soak = 0);
+    // Copies a w x h block of packed row-major cells with its top-left cell at (x, y)
+    void BlitRegion(int x, int y, int w, int h, const PackedCell* cells);
+    // Blits a prefab, leaving the cells under its empty cells as they are
+    void StampRegion(int x, int y, int w, int h, const PackedCell* cells);
+
+    // Marks every cell whose update rule reads (x, y) for processing next tick.
+    // Readers sit up to two rows above (TryWetSand's {0, 2} probe) and one row below.
+    void WakeCell(int x, int y) {
+        WakeRect(x - 1, y - 2, x + 1, y + 1);
+    }
+
+    // Moves and swaps are between neighbours, so one covering rect is cheaper than two wakes
+    void WakePair(int x1, int y1, int x2, int y2) {
+        WakeRect(std::min(x1, x2) - 1, std::min(y1, y2) - 2, std::max(x1, x2) + 1, std::max(y1, y2) + 1);
+    }
+
+    void WakeRect(int x0, int y0, int x1, int y1) {
+        if (m_sparseActive) QueueRect(x0, y0, x1, y1);
+
+        // Fast path: the rect lies inside the grid and within a single chunk
+        if (x0 >= 0 && y0 >= 0 && x1 < width && y1 < height &&
+            x0 / CHUNK_SIZE == x1 / CHUNK_SIZE && y0 / CHUNK_SIZE == y1 / CHUNK_SIZE) {
+            const int cx = x0 / CHUNK_SIZE;
+            const int cy = y0 / CHUNK_SIZE;
+            m_nextRects[cy * m_chunksX + cx].Include(x0, y0, x1, y1);
+            if (IsAheadOfPass(cx, cy)) m_rects[cy * m_chunksX + cx].Include(x0, y0, x1, y1);
+            return;
+        }
+        WakeRectSlow(x0, y0, x1, y1);
+    }
+
+    void WakeRectSlow(int x0, int y0, int x1, int y1);
+    void WakeAll();
+    void QueueRect(int x0, int y0, int x1, int y1);
+
+    [[nodiscard]] int GetChunksX() const { return m_chunksX; }
+    [[nodiscard]] int GetChunksY() const { return m_chunksY; }
+    [[nodiscard]] const DirtyRect& GetChunkRect(int cx, int cy) const { return m_rects[cy * m_chunksX + cx]; }
+    [[nodiscard]] const std::vector<DirtyRect>& GetChunkRects() const { return m_rects; }
+    [[nodiscard]] int GetAwakeChunkCount() const;
+    [[nodiscard]] bool IsChunkCoarse(int cx, int cy) const { return m_coarse[cy * m_chunksX + cx] != 0; }
+    [[nodiscard]] int GetCoarseChunkCount() const { return m_coarseChunkCount; }
+
+    // High-rate region around the tool. UpdateRegion() advances only the cells inside it,
+    // as often as the caller likes between full ticks, and Update() leaves those cells
+    // alone, so each cell runs at exactly one rate. Both sides apply the same rules to the
+    // same cells, so material crossing the border just changes hands. The region runs
+    // the per-cell rules; the Margolus engine has none and ignores it.
+    // Clamped to the grid; an empty rect turns the region off. Returns true if it changed.
+    bool SetRegion(const DirtyRect& region);
+    [[nodiscard]] const DirtyRect& GetRegion() const { return m_region; }
+    [[nodiscard]] bool HasRegion() const { return !m_region.IsEmpty() && engine != UpdateEngine::Margolus; }
+    void UpdateRegion();
+
+    [[nodiscard]] uint64_t GetTickCount() const override { return m_tickCount; }
+    [[nodiscard]] int64_t GetOccupiedCount() const { return m_occupiedCount; }
+    [[nodiscard]] bool IsSparseActive() const { return m_sparseActive; }
+    [[nodiscard]] int GetWorklistSize() const { return static_cast<int>(m_nextActive.size()); }
+
+    // Packed row-major copy of the grid, e.g. for handing to another thread
+    void ExportCells(std::vector<PackedCell>& out) const override;
+
+    // Packed row-major copy of chunk (cx, cy)'s CHUNK_CELLS cells; cells past the grid
+    // edge read Empty
+    void ExportChunk(int cx, int cy, PackedCell* out) const;
+    // Flags the chunks that may have changed since the last call and starts over. Waking
+    // a chunk is not writing to it, so this is a superset.
+    void TakeEditedChunks(std::vector<uint8_t>& out);
+
+    // Row occupancy bitmaps, GetOccupancyWords() 64-bit words per row: bit x % 64 of word
+    // x / 64 is set while cell (x, y) is not Empty. Bits past the width are zero.
+    [[nodiscard]] int GetOccupancyWords() const { return m_occupancyWords; }
+    // Row-major copy of the bitmaps, whatever the bands they are stored in
+    void ExportOccupancy(std::vector<uint64_t>& out) const;
+
+    // Storage-independent hash of every cell, for comparing runs against golden grids
+    [[nodiscard]] uint64_t ComputeGridHash() const;
+
+    [[nodiscard]] float GetResistance(float cx, float cy, float radius) const override;
+    [[nodiscard]] glm::ivec2 FindNearestEmpty(int targetX, int targetY, int maxRadius) const;
+    // Moves every occupied cell in the disk to the nearest empty cell just outside it
+    void Displace(const glm::vec2& center, float radius) override;
+
+    // --- Backend ---
+    void Step() override { Update(); }
+    [[nodiscard]] int GetWidth() const override { return width; }
+    [[nodiscard]] int GetHeight() const override { return height; }
+    void Paint(int x, int y, MaterialType type, int soak) override { Set(x, y, type, soak); }
+    void PaintStroke(const glm::vec2& from, const glm::vec2& to, float radius, MaterialType type, int soak) override {
+        FillLine(from, to, radius, type, soak);
+    }
+
+    void Update();
+
+private:
+    [[nodiscard]] bool WantsSparse() const;
+    void SetSparseActive(bool active);
+    void UpdateSparse();
+    void ClearWorklist();
+    void UpdatePhased();
+    // Runs update(chunkIndex, worker) for every awake chunk in `rects`, one checkerboard
+    // colour at a time. With `pickUpWakes`, chunks woken for a later phase join this pass.
+    template <typename Fn>
+    void ForEachChunkPhased(const std::vector<DirtyRect>& rects, Fn&& update, bool pickUpWakes = false);
+    void UpdateChunk(int chunkIndex);
+    // The bitboard kernel needs contiguous rows and updates whole rows, which neither
+    // multi-resolution nor the high-rate region can split; otherwise it falls back to Scan
+    [[nodiscard]] bool UsesBitboard() const {
+        return engine == UpdateEngine::Bitboard && m_layout == GridLayout::RowMajor && !multiResolution && !HasRegion();
+    }
+    void UpdateBitboard();
+    [[nodiscard]] bool IsRowAwake(int y) const;
+    void BuildRowMask(int y, MaterialType type, uint64_t* out) const;
+    // Updates cells x0..x1 of row y left to right, skipping bed cells
+    void UpdateSpan(int y, int x0, int x1);
+    void UpdateRun(int y, int x0, int x1);
+    template <bool Interior>
+    void UpdateCell(int x, int y);
+
+    // Blocks belong to the chunk holding their top-left cell; these return the change in
+    // occupied cells
+    void UpdateMargolus();
+    [[nodiscard]] int64_t UpdateChunkBlocks(int chunkIndex);
+    [[nodiscard]] int UpdateBlock(int bx, int by, bool lateralFlow);
+
+    // Coarse blocks are COARSE_BLOCK_SIZE cells square, addressed in block coordinates.
+    // Transfers return the cells moved, UpdateCoarseBlock the change in occupied cells.
+    struct BlockCounts {
+        int empty = 0;
+        int occupied = 0;
+        int liquid = 0;
+    };
+    void RouteCoarseChunks();
+    void UpdateCoarse();
+    [[nodiscard]] int64_t UpdateCoarseChunk(int chunkIndex);
+    [[nodiscard]] int UpdateCoarseBlock(int bx, int by);
+    [[nodiscard]] BlockCounts CountBlock(int bx, int by) const;
+    int MoveBlockCells(int fromX, int fromY, int toX, int toY, uint32_t typeMask, int limit);
+    int SinkBlockCells(int bx, int by);
+    [[nodiscard]] int WetBlock(int bx, int by);
+    bool PackBlock(int bx, int by);
+
+    // Collapsing reads whole columns, which paged worlds are too large for
+    [[nodiscard]] bool UsesHeightfield() const {
+        return heightfield && engine == UpdateEngine::Scan && !multiResolution && !m_paged;
+    }
+    void NoteBedWrite(int x, int y) {
+        if (m_bedColumns == 0 || y < m_bedTops[x]) return;
+        // Chunks stacked in one parallel phase share every column
+        if (m_inParallelPhase) __atomic_fetch_or(&m_bedFlags[x], BED_DISTURBED, __ATOMIC_RELAXED);
+        else m_bedFlags[x] |= BED_DISTURBED;
+    }
+    void UpdateHeightfield();
+    // Expands, grows and avalanches the existing beds
+    void UpdateBeds();
+    bool TryCollapseColumn(int x);
+    void ExpandColumn(int x);
+    // Whether the cells of expanded column n still hold up the bed of column x
+    [[nodiscard]] bool IsBedSupported(int x, int n) const;
+    // Slides sand from the taller of two adjacent beds to the shorter until they differ
+    // by at most a cell, as the cell rules would
+    void AvalanchePair(int x, int n);
+
+    // Leveling scans the whole grid, which paged worlds are too large for
+    [[nodiscard]] bool IsHydrostatic() const { return waterMode == WaterMode::Hydrostatic && !m_paged; }
+    int FindWaterBody(int run);
+    [[nodiscard]] bool IsWaterAwake() const;
+    void LevelWater();
+
+    [[nodiscard]] bool CoinFlip(int x, int y) const {
+        return CounterCoinFlip(seed, m_tickCount ^ (static_cast<uint64_t>(m_regionTick) << 48), x, y);
+    }
+
+    // One update kernel per material, specialized on its descriptor in material.h and on
+    // whether the cell is interior
+    template <MaterialType Type, bool Interior>
+    void UpdateMaterial(int x, int y);
+    template <MaterialType Type, bool Interior>
+    bool TryWet(int wx, int wy);
+};
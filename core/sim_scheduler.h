@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+
+// --- Simulation Scheduler ---
+// Fixed-timestep driver: wall time accumulates into a debt that is paid off in whole
+// ticks, several per frame when behind. Debt beyond maxCatchUpMs is dropped so a
+// simulation that cannot keep up degrades to "as fast as possible" instead of spiralling.
+class SimScheduler {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    double m_accumulatorMs = 0.0;
+    double m_droppedMs = 0.0;
+
+    // Measured rate over a sliding window
+    Clock::time_point m_windowStart = Clock::now();
+    long long m_windowTicks = 0;
+    double m_measuredTicksPerSecond = 0.0;
+
+    void RecordTicks(int ticks) {
+        m_windowTicks += ticks;
+        double windowSeconds = std::chrono::duration<double>(Clock::now() - m_windowStart).count();
+        if (windowSeconds >= 0.5) {
+            m_measuredTicksPerSecond = static_cast<double>(m_windowTicks) / windowSeconds;
+            m_windowTicks = 0;
+            m_windowStart = Clock::now();
+        }
+    }
+
+public:
+    float speedMultiplier = 1.0f;
+    float maxCatchUpMs = 100.0f;
+    // Wall-clock budget for ticking inside one Advance call
+    float frameBudgetMs = 12.0f;
+
+    // Runs tick() once per whole stepMs of (scaled) elapsed time and returns the tick count
+    template <typename TickFn>
+    int Advance(double elapsedMs, double stepMs, TickFn&& tick) {
+        stepMs = std::max(stepMs, 1e-3);
+        m_accumulatorMs += elapsedMs * speedMultiplier;
+
+        Clock::time_point start = Clock::now();
+        int ticks = 0;
+        while (m_accumulatorMs >= stepMs) {
+            tick();
+            m_accumulatorMs -= stepMs;
+            ++ticks;
+
+            // Check the clock every few ticks; at sub-microsecond steps it is not free
+            if ((ticks & 7) == 0 &&
+                std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= frameBudgetMs) {
+                break;
+            }
+        }
+
+        double limitMs = std::max(static_cast<double>(maxCatchUpMs), stepMs);
+        if (m_accumulatorMs > limitMs) {
+            m_droppedMs += m_accumulatorMs - limitMs;
+            m_accumulatorMs = limitMs;
+        }
+
+        RecordTicks(ticks);
+        return ticks;
+    }
+
+    void Reset() {
+        m_accumulatorMs = 0.0;
+        m_droppedMs = 0.0;
+    }
+
+    [[nodiscard]] double GetMeasuredTicksPerSecond() const { return m_measuredTicksPerSecond; }
+    [[nodiscard]] double GetBacklogMs() const { return m_accumulatorMs; }
+    [[nodiscard]] double GetDroppedMs() const { return m_droppedMs; }
+};
@@ -0,0 +1,45 @@
+#include "core/sim_settings.h"
+
+SimSettings SimSettings::Capture(const SandSimulation& sim, const HapticSystem& haptics, const SimScheduler& scheduler) {
+    SimSettings settings;
+    settings.tickDelayMs = sim.tickDelayMs;
+    settings.speedMultiplier = scheduler.speedMultiplier;
+    settings.maxCatchUpMs = scheduler.maxCatchUpMs;
+    settings.chunkSleeping = sim.chunkSleeping;
+    settings.threadCount = sim.threadCount;
+    settings.engine = sim.engine;
+    settings.worklistMode = sim.worklistMode;
+    settings.waterMode = sim.waterMode;
+    settings.layout = sim.GetLayout();
+    settings.multiResolution = sim.multiResolution;
+    settings.heightfield = sim.heightfield;
+
+    settings.axis = haptics.currentAxis;
+    settings.mode = haptics.currentMode;
+    settings.radius = haptics.radius;
+    settings.frictionCoef = haptics.frictionCoef;
+    settings.hapkitScale = haptics.hapkitScale;
+    settings.springK = haptics.springK;
+    return settings;
+}
+
+void SimSettings::ApplyTo(SandSimulation& sim, HapticSystem& haptics, SimScheduler& scheduler) const {
+    sim.tickDelayMs = tickDelayMs;
+    scheduler.speedMultiplier = speedMultiplier;
+    scheduler.maxCatchUpMs = maxCatchUpMs;
+    sim.chunkSleeping = chunkSleeping;
+    sim.threadCount = threadCount;
+    sim.engine = engine;
+    sim.worklistMode = worklistMode;
+    sim.waterMode = waterMode;
+    if (!sim.IsPaged()) sim.SetLayout(layout);
+    sim.multiResolution = multiResolution;
+    sim.heightfield = heightfield;
+
+    haptics.currentAxis = axis;
+    haptics.currentMode = mode;
+    haptics.radius = radius;
+    haptics.frictionCoef = frictionCoef;
+    haptics.hapkitScale = hapkitScale;
+    haptics.springK = springK;
+}
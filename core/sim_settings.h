@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+#include "core/cell.h"
+#include "core/haptic_system.h"
+#include "core/sand_simulation.h"
+#include "core/sim_scheduler.h"
+
+// User-tunable parameters, edited on the UI thread and applied by the simulation thread
+struct SimSettings {
+    float tickDelayMs = TICK_DELAY_DEFAULT;
+    float speedMultiplier = 1.0f;
+    float maxCatchUpMs = 100.0f;
+    bool chunkSleeping = true;
+    int threadCount = 1;
+    UpdateEngine engine = UpdateEngine::Scan;
+    WorklistMode worklistMode = WorklistMode::Auto;
+    WaterMode waterMode = WaterMode::Cellular;
+    GridLayout layout = GridLayout::RowMajor;  // Ignored for paged worlds
+    bool multiResolution = false;
+    bool heightfield = false;
+    // Switched by the simulation thread. Journals and snapshots cover the cellular backend
+    // only, so Capture always reports it.
+    BackendType backend = BackendType::Cellular;
+    // High-rate region around the haptic proxy, also run by the simulation thread; see
+    // SandSimulation::SetRegion
+    bool highRateRegion = false;
+    float regionRadii = 4.0f;  // Half-width of the region in tool radii
+    float regionRateHz = 1000.0f;
+    // Ticks between automatic checkpoints, 0 for none; also kept by the simulation thread
+    int checkpointIntervalTicks = 0;
+
+    HapticSystem::AxisMode axis = HapticSystem::AxisMode::X_Axis;
+    HapticSystem::ControlMode mode = HapticSystem::ControlMode::Mode_1DOF;
+    float radius = 4.0f;
+    float frictionCoef = 5.0f;
+    float hapkitScale = 500.0f;
+    float springK = 0.5f;
+
+    // Bumped when the simulation thread changes settings itself, e.g. on loading a
+    // snapshot; updates based on an older revision are dropped
+    uint64_t revision = 0;
+
+    static SimSettings Capture(const SandSimulation& sim, const HapticSystem& haptics, const SimScheduler& scheduler);
+    void ApplyTo(SandSimulation& sim, HapticSystem& haptics, SimScheduler& scheduler) const;
+};
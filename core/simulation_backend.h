@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "core/cell.h"
+#include "core/cell_storage.h"
+
+enum class BackendType {
+    Cellular,   // SandSimulation
+    Particles,  // ParticleSimulation
+    Count
+};
+
+// --- Simulation Backend ---
+// What the haptics, the simulation thread and the renderer need from a world, so the
+// cellular grid and the particle solver are interchangeable behind them. Coordinates
+// are in grid cells for both.
+class SimulationBackend {
+public:
+    virtual ~SimulationBackend() = default;
+
+    // Advances the world by one tick
+    virtual void Step() = 0;
+
+    [[nodiscard]] virtual int GetWidth() const = 0;
+    [[nodiscard]] virtual int GetHeight() const = 0;
+    [[nodiscard]] virtual uint64_t GetTickCount() const = 0;
+
+    // Fills cell (x, y) with `type`, e.g. from the paint brush
+    virtual void Paint(int x, int y, MaterialType type, int soak) = 0;
+    // Fills every cell within `radius` of the segment between two brush samples
+    virtual void PaintStroke(const glm::vec2& from, const glm::vec2& to, float radius, MaterialType type, int soak) = 0;
+    virtual void Clear() = 0;
+
+    // Summed drag of the material covering the disk, in cell-resistance units
+    [[nodiscard]] virtual float GetResistance(float cx, float cy, float radius) const = 0;
+    // Pushes material out of the disk the haptic proxy occupies
+    virtual void Displace(const glm::vec2& center, float radius) = 0;
+
+    // Packed row-major raster of the world for rendering
+    virtual void ExportCells(std::vector<PackedCell>& out) const = 0;
+};
@@ -0,0 +1,328 @@
+#include "core/simulation_thread.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "core/bitboard_kernel.h"
+
+SimulationThread::SimulationThread() {
+    m_settings = SimSettings::Capture(m_sim, m_haptics, m_scheduler);
+}
+
+SimulationThread::~SimulationThread() { Stop(); }
+
+void SimulationThread::Start() {
+    if (m_running) return;
+
+    // The reader always finds a valid frame, even before the first loop iteration
+    Publish();
+    m_running = true;
+    m_thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop() {
+    if (!m_running) return;
+    m_running = false;
+    m_thread.join();
+}
+
+SimSettings SimulationThread::GetSettings() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_settings;
+}
+
+void SimulationThread::SetSettings(const SimSettings& settings) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (settings.revision != m_settings.revision) return;
+    m_settings = settings;
+    m_settingsDirty = true;
+}
+
+void SimulationThread::SetInput(const SimInput& input) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_input = input;
+}
+
+void SimulationThread::Post(std::function<void()> command) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_commands.push_back(std::move(command));
+}
+
+void SimulationThread::Paint(int x, int y, MaterialType type, int soak) {
+    Post([this, x, y, type, soak] {
+        m_world->Paint(x, y, type, soak);
+        m_journal.RecordPaint(x, y, type, soak);
+    });
+}
+
+void SimulationThread::PaintStroke(const glm::vec2& from, const glm::vec2& to, float radius, MaterialType type, int soak) {
+    Post([this, from, to, radius, type, soak] {
+        m_world->PaintStroke(from, to, radius, type, soak);
+        m_journal.RecordStroke(from, to, radius, type, soak);
+    });
+}
+
+void SimulationThread::Clear() {
+    Post([this] {
+        m_world->Clear();
+        m_journal.RecordClear();
+    });
+}
+
+void SimulationThread::Recenter(const glm::vec2& center) {
+    Post([this, center] {
+        m_haptics.Recenter(center);
+        m_journal.RecordRecenter(center);
+    });
+}
+
+void SimulationThread::Connect(const std::string& port) {
+    Post([this, port] {
+        m_device.port = port;
+        m_device.Connect();
+    });
+}
+
+void SimulationThread::Disconnect() {
+    Post([this] { m_device.Disconnect(); });
+}
+
+void SimulationThread::Save(const std::string& path, SnapshotEncoding encoding) {
+    Post([this, path, encoding] {
+        if (m_world != &m_sim) {
+            std::cerr << "[Error] Save: snapshots need the cellular backend" << std::endl;
+            return;
+        }
+        SaveSnapshot(path, m_sim, &m_haptics, encoding);
+    });
+}
+
+void SimulationThread::Load(const std::string& path) {
+    Post([this, path] {
+        if (!LoadSnapshot(path, m_sim, &m_haptics)) return;
+        m_journal.RecordLoad(m_sim, m_haptics);
+        m_world = &m_sim;
+
+        // The snapshot's haptic configuration replaces whatever the UI last sent
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_settings = SimSettings::Capture(m_sim, m_haptics, m_scheduler);
+        m_settings.highRateRegion = m_regionEnabled;
+        m_settings.regionRadii = m_regionRadii;
+        m_settings.regionRateHz = m_regionRateHz;
+        m_settings.checkpointIntervalTicks = m_checkpointIntervalTicks;
+        m_settings.revision = ++m_settingsRevision;
+        m_settingsDirty = false;
+    });
+}
+
+void SimulationThread::StartRecording(const std::string& path) {
+    Post([this, path] {
+        if (m_world != &m_sim) {
+            std::cerr << "[Error] StartRecording: journals need the cellular backend" << std::endl;
+            return;
+        }
+        if (m_journal.Start(path, m_sim, m_haptics, SimSettings::Capture(m_sim, m_haptics, m_scheduler))) {
+            m_journal.RecordRegion(m_sim.GetRegion());
+        }
+    });
+}
+
+void SimulationThread::StopRecording() {
+    Post([this] { m_journal.Stop(); });
+}
+
+void SimulationThread::Checkpoint() {
+    Post([this] {
+        if (m_world != &m_sim) {
+            std::cerr << "[Error] Checkpoint: checkpoints need the cellular backend" << std::endl;
+            return;
+        }
+        m_timeline.Capture(m_sim, m_haptics);
+    });
+}
+
+void SimulationThread::Rewind(size_t index) {
+    Post([this, index] {
+        if (m_world != &m_sim) {
+            std::cerr << "[Error] Rewind: checkpoints need the cellular backend" << std::endl;
+            return;
+        }
+        if (m_timeline.Rewind(index, m_sim, m_haptics)) m_journal.Stop();
+    });
+}
+
+void SimulationThread::ClearCheckpoints() {
+    Post([this] { m_timeline.Clear(); });
+}
+
+void SimulationThread::SelectBackend(BackendType backend) {
+    SimulationBackend* world = backend == BackendType::Particles ? static_cast<SimulationBackend*>(&m_particles) : &m_sim;
+    if (world == m_world) return;
+
+    // The new backend starts from the old one's cells
+    std::vector<PackedCell> cells;
+    m_world->ExportCells(cells);
+    if (world == &m_particles) {
+        m_journal.Stop();
+        m_particles.LoadCells(m_sim.width, m_sim.height, cells);
+    } else {
+        CellBuffer<PackedCell> buffer;
+        buffer.Assign(cells.size(), PackCell(Cell{}));
+        std::copy(cells.begin(), cells.end(), buffer.Data());
+        m_sim.LoadCells(m_particles.width, m_particles.height, std::move(buffer));
+    }
+    m_world = world;
+}
+
+const SimSnapshot& SimulationThread::AcquireSnapshot() {
+    m_snapshots.Acquire();
+    return m_snapshots.Front();
+}
+
+void SimulationThread::Run() {
+    Clock::time_point last = Clock::now();
+    std::vector<std::function<void()>> commands;
+
+    while (m_running) {
+        Clock::time_point now = Clock::now();
+        double elapsedMs = std::chrono::duration<double, std::milli>(now - last).count();
+        last = now;
+
+        SimInput input;
+        bool settingsApplied = false;
+        SimSettings appliedSettings;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            commands.swap(m_commands);
+            input = m_input;
+            if (m_settingsDirty) {
+                m_settings.ApplyTo(m_sim, m_haptics, m_scheduler);
+                m_settingsDirty = false;
+                settingsApplied = true;
+                appliedSettings = m_settings;
+            }
+        }
+        if (settingsApplied) {
+            m_particles.threadCount = appliedSettings.threadCount;
+            SelectBackend(appliedSettings.backend);
+            m_regionEnabled = appliedSettings.highRateRegion;
+            m_regionRadii = appliedSettings.regionRadii;
+            m_regionRateHz = appliedSettings.regionRateHz;
+            m_checkpointIntervalTicks = appliedSettings.checkpointIntervalTicks;
+            m_journal.RecordSettings(appliedSettings);
+        }
+        for (const auto& command : commands) command();
+        commands.clear();
+
+        m_scheduler.Advance(elapsedMs, m_sim.tickDelayMs, [this] {
+            m_world->Step();
+            m_journal.RecordTick();
+            if (m_checkpointIntervalTicks > 0 && m_world == &m_sim && !m_sim.IsPaged() &&
+                m_sim.GetTickCount() % m_checkpointIntervalTicks == 0) {
+                m_timeline.Capture(m_sim, m_haptics);
+            }
+        });
+        StepRegion(elapsedMs);
+        StepHaptics(input);
+
+        if (std::chrono::duration<double, std::milli>(Clock::now() - m_lastPublish).count() >= publishPeriodMs) {
+            Publish();
+        }
+
+        std::this_thread::sleep_until(now + std::chrono::duration_cast<Clock::duration>(
+                                                  std::chrono::duration<double, std::milli>(loopPeriodMs)));
+    }
+}
+
+void SimulationThread::StepRegion(double elapsedMs) {
+    DirtyRect region;
+    if (m_regionEnabled && m_world == &m_sim) {
+        const glm::vec2 reach(m_haptics.radius * m_regionRadii);
+        const glm::ivec2 lo = glm::ivec2(glm::floor(m_haptics.proxyPos - reach));
+        const glm::ivec2 hi = glm::ivec2(glm::ceil(m_haptics.proxyPos + reach));
+        region = { lo.x, lo.y, hi.x, hi.y };
+    }
+    if (m_sim.SetRegion(region)) m_journal.RecordRegion(m_sim.GetRegion());
+    if (!m_sim.HasRegion()) {
+        m_regionScheduler.Reset();
+        return;
+    }
+
+    m_regionScheduler.speedMultiplier = m_scheduler.speedMultiplier;
+    m_regionScheduler.maxCatchUpMs = m_scheduler.maxCatchUpMs;
+    m_regionScheduler.Advance(elapsedMs, 1000.0 / std::max(m_regionRateHz, 1.0f), [this] {
+        m_sim.UpdateRegion();
+        m_journal.RecordRegionTick();
+    });
+}
+
+void SimulationThread::StepHaptics(const SimInput& input) {
+    if (m_device.connected) m_device.Sync(m_haptics.currentForce1D);
+
+    // Resolved up front so the journal records exactly what the haptics saw
+    glm::vec2 mousePos = m_haptics.devicePos;
+    float rawInputMeters = 0.0f;
+    bool isMouseInput = false;
+    if (input.hovered && input.driveWithMouse) {
+        mousePos = input.mouseGridPos;
+        isMouseInput = true;
+    } else if (input.hovered || (!input.driveWithMouse && m_device.connected)) {
+        mousePos = glm::vec2(0, 0);
+        rawInputMeters = m_device.GetPositionMeters();
+    }
+
+    m_haptics.Update(mousePos, rawInputMeters, isMouseInput, *m_world);
+    m_journal.RecordHaptics(mousePos, rawInputMeters, isMouseInput);
+}
+
+void SimulationThread::Publish() {
+    SimSnapshot& snapshot = m_snapshots.Back();
+    snapshot.width = m_world->GetWidth();
+    snapshot.height = m_world->GetHeight();
+    m_world->ExportCells(snapshot.cells);
+    if (m_world == &m_sim) {
+        m_sim.ExportOccupancy(snapshot.occupancy);
+        snapshot.occupancyWords = m_sim.GetOccupancyWords();
+        snapshot.chunksX = m_sim.GetChunksX();
+        snapshot.chunksY = m_sim.GetChunksY();
+        snapshot.chunkRects = m_sim.GetChunkRects();
+        snapshot.coarseChunks.resize(snapshot.chunkRects.size());
+        for (int cy = 0; cy < snapshot.chunksY; ++cy) {
+            for (int cx = 0; cx < snapshot.chunksX; ++cx) snapshot.coarseChunks[cy * snapshot.chunksX + cx] = m_sim.IsChunkCoarse(cx, cy);
+        }
+        snapshot.region = m_sim.GetRegion();
+        snapshot.sparseActive = m_sim.IsSparseActive();
+        snapshot.occupiedCount = m_sim.GetOccupiedCount();
+        snapshot.bedColumnCount = m_sim.GetBedColumnCount();
+        snapshot.grainCount = 0;
+    } else {
+        // Grains have no chunks; the overlay stays empty and occupancy comes from the raster
+        snapshot.occupancyWords = bitboard::WordCount(snapshot.width);
+        snapshot.occupancy.resize(static_cast<size_t>(snapshot.occupancyWords) * snapshot.height);
+        snapshot.occupiedCount = 0;
+        for (int y = 0; y < snapshot.height; ++y) {
+            uint64_t* row = &snapshot.occupancy[static_cast<size_t>(y) * snapshot.occupancyWords];
+            bitboard::BuildOccupancyMask(&snapshot.cells[static_cast<size_t>(y) * snapshot.width], snapshot.width, row);
+            for (int w = 0; w < snapshot.occupancyWords; ++w) snapshot.occupiedCount += __builtin_popcountll(row[w]);
+        }
+        snapshot.chunkRects.clear();
+        snapshot.coarseChunks.clear();
+        snapshot.region = DirtyRect{};
+        snapshot.sparseActive = false;
+        snapshot.grainCount = m_particles.GetGrainCount();
+        snapshot.bedColumnCount = 0;
+    }
+    snapshot.haptics = m_haptics;
+    snapshot.deviceConnected = m_device.connected;
+    snapshot.tick = m_world->GetTickCount();
+    snapshot.ticksPerSecond = m_scheduler.GetMeasuredTicksPerSecond();
+    snapshot.backlogMs = m_scheduler.GetBacklogMs();
+    snapshot.regionTicksPerSecond = m_sim.HasRegion() ? m_regionScheduler.GetMeasuredTicksPerSecond() : 0.0;
+    snapshot.settingsRevision = m_settingsRevision;
+    snapshot.recording = m_journal.IsRecording();
+    snapshot.checkpointTicks.resize(m_timeline.GetCount());
+    for (size_t i = 0; i < m_timeline.GetCount(); ++i) snapshot.checkpointTicks[i] = m_timeline.Get(i).tickCount;
+    snapshot.checkpointBytes = m_timeline.GetBytes();
+    m_snapshots.Publish();
+    m_lastPublish = Clock::now();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "core/cell_storage.h"
+#include "core/checkpoint_timeline.h"
+#include "core/haptic_device.h"
+#include "core/haptic_system.h"
+#include "core/input_journal.h"
+#include "core/particle_simulation.h"
+#include "core/sand_simulation.h"
+#include "core/sim_scheduler.h"
+#include "core/sim_settings.h"
+#include "core/snapshot_file.h"
+#include "core/triple_buffer.h"
+
+// Per-frame pointer state from the Simulation View
+struct SimInput {
+    glm::vec2 mouseGridPos = { 0.0f, 0.0f };
+    bool hovered = false;
+    bool driveWithMouse = true;
+};
+
+// Immutable copy of everything the renderer needs, published by the simulation thread
+struct SimSnapshot {
+    int width = 0;
+    int height = 0;
+    std::vector<PackedCell> cells;
+    // Row occupancy bitmaps, occupancyWords per row; bit x % 64 of word x / 64 is set when
+    // cell x of the row is not Empty, so the view draws occupied cells without testing all
+    std::vector<uint64_t> occupancy;
+    int occupancyWords = 0;
+    int chunksX = 0;
+    int chunksY = 0;
+    std::vector<DirtyRect> chunkRects;
+    std::vector<uint8_t> coarseChunks;  // Multi-resolution, per chunk
+    DirtyRect region;  // High-rate region, empty while off
+    double regionTicksPerSecond = 0.0;
+    bool sparseActive = false;
+    int64_t occupiedCount = 0;
+    int bedColumnCount = 0;
+    size_t grainCount = 0;  // Particle backend only
+    HapticSystem haptics;
+    bool deviceConnected = false;
+    uint64_t tick = 0;
+    double ticksPerSecond = 0.0;
+    double backlogMs = 0.0;
+    uint64_t settingsRevision = 0;
+    bool recording = false;
+    std::vector<uint64_t> checkpointTicks;  // Tick of each checkpoint, oldest first
+    size_t checkpointBytes = 0;
+
+    [[nodiscard]] Cell Get(int x, int y) const { return UnpackCell(cells[y * width + x]); }
+    [[nodiscard]] const uint64_t* GetOccupancyRow(int y) const { return &occupancy[static_cast<size_t>(y) * occupancyWords]; }
+};
+
+// --- Simulation Thread ---
+// Owns the simulation, haptics and serial device and runs them on a dedicated thread.
+// Everything else talks to it through settings, input, queued commands and snapshots.
+class SimulationThread {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    SandSimulation m_sim;
+    ParticleSimulation m_particles;
+    SimulationBackend* m_world = &m_sim;  // Whichever backend is stepped, painted and felt
+    HapticSystem m_haptics;
+    HapticDevice m_device;
+    SimScheduler m_scheduler;
+    JournalRecorder m_journal;
+
+    // High-rate region: follows the proxy and gets its own tick debt, so its sub-ticks
+    // keep their rate whatever the full tick rate is
+    SimScheduler m_regionScheduler;
+    bool m_regionEnabled = false;
+    float m_regionRadii = 4.0f;
+    float m_regionRateHz = 1000.0f;
+
+    CheckpointTimeline m_timeline;
+    int m_checkpointIntervalTicks = 0;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+
+    std::mutex m_mutex;
+    SimSettings m_settings;
+    bool m_settingsDirty = false;
+    SimInput m_input;
+    std::vector<std::function<void()>> m_commands;
+    uint64_t m_settingsRevision = 0;  // Simulation thread's copy of m_settings.revision
+
+    TripleBuffer<SimSnapshot> m_snapshots;
+    Clock::time_point m_lastPublish;
+
+    void Run();
+    void SelectBackend(BackendType backend);
+    void StepRegion(double elapsedMs);
+    void StepHaptics(const SimInput& input);
+    void Publish();
+    void Post(std::function<void()> command);
+
+public:
+    // Haptics and serial I/O run once per loop; the loop sleeps to keep roughly this period
+    double loopPeriodMs = 1.0;
+    // Snapshots are copied at most this often
+    double publishPeriodMs = 4.0;
+
+    SimulationThread();
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void Start();
+    void Stop();
+
+    [[nodiscard]] SimSettings GetSettings();
+    void SetSettings(const SimSettings& settings);
+    void SetInput(const SimInput& input);
+
+    void Paint(int x, int y, MaterialType type, int soak);
+    // Fills every cell within `radius` of the segment between two brush samples
+    void PaintStroke(const glm::vec2& from, const glm::vec2& to, float radius, MaterialType type, int soak);
+    void Clear();
+    void Recenter(const glm::vec2& center);
+    void Connect(const std::string& port);
+    void Disconnect();
+    void Save(const std::string& path, SnapshotEncoding encoding);
+    void Load(const std::string& path);
+    // Journals every tick, input and edit from now on; see input_journal.h
+    void StartRecording(const std::string& path);
+    void StopRecording();
+    // In-memory checkpoints of the cellular world; see checkpoint_timeline.h. A journal
+    // cannot replay a rewind, so rewinding stops the recording.
+    void Checkpoint();
+    void Rewind(size_t index);
+    void ClearCheckpoints();
+
+    // Reader side of the triple buffer; call from one thread only
+    const SimSnapshot& AcquireSnapshot();
+};
@@ -0,0 +1,282 @@
+#include "core/snapshot_file.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "core/cell_buffer.h"
+#include "core/cell_storage.h"
+#include "core/haptic_system.h"
+#include "core/mapped_region.h"
+#include "core/sand_simulation.h"
+
+namespace {
+
+constexpr char SNAPSHOT_MAGIC[8] = { 'S', 'A', 'N', 'D', 'S', 'N', 'A', 'P' };
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+constexpr uint32_t SNAPSHOT_HAS_HAPTICS = 0x1;
+// Every column's bed top as an int32, then its bed flags as a byte, after the cells
+constexpr uint32_t SNAPSHOT_HAS_BEDS = 0x2;
+constexpr size_t SNAPSHOT_BED_COLUMN_BYTES = sizeof(int32_t) + sizeof(uint8_t);
+// Raw cells start on a page boundary so they can be mapped in place
+constexpr size_t SNAPSHOT_CELL_ALIGN = 4096;
+// A snapshot loads into a heap world, so its size is checked before anything is
+// allocated; worlds past this are what paged worlds are for
+constexpr int32_t SNAPSHOT_MAX_SIDE = 1 << 15;
+constexpr size_t SNAPSHOT_MAX_CELLS = size_t{ 1 } << 28;
+
+struct HapticRecord {
+    float proxyPos[2];
+    float devicePos[2];
+    float anchorPos[2];
+    float smoothedResistance;
+    float currentForce1D;
+    float rawInputVal;
+    float radius;
+    float frictionCoef;
+    float hapkitScale;
+    float springK;
+    int32_t axis;
+    int32_t mode;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t encoding;
+    int32_t width;
+    int32_t height;
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t seed;
+    uint64_t tickCount;
+    int64_t occupiedCount;
+    uint64_t cellOffset;
+    uint64_t cellBytes;
+    HapticRecord haptics;
+    uint64_t bedOffset;
+    uint64_t bedBytes;
+};
+
+HapticRecord CaptureHaptics(const HapticSystem& haptics) {
+    HapticRecord record{};
+    record.proxyPos[0] = haptics.proxyPos.x;
+    record.proxyPos[1] = haptics.proxyPos.y;
+    record.devicePos[0] = haptics.devicePos.x;
+    record.devicePos[1] = haptics.devicePos.y;
+    record.anchorPos[0] = haptics.anchorPos.x;
+    record.anchorPos[1] = haptics.anchorPos.y;
+    record.smoothedResistance = haptics.smoothedResistance;
+    record.currentForce1D = haptics.currentForce1D;
+    record.rawInputVal = haptics.rawInputVal;
+    record.radius = haptics.radius;
+    record.frictionCoef = haptics.frictionCoef;
+    record.hapkitScale = haptics.hapkitScale;
+    record.springK = haptics.springK;
+    record.axis = static_cast<int32_t>(haptics.currentAxis);
+    record.mode = static_cast<int32_t>(haptics.currentMode);
+    return record;
+}
+
+void RestoreHaptics(const HapticRecord& record, HapticSystem& haptics) {
+    haptics.proxyPos = glm::vec2(record.proxyPos[0], record.proxyPos[1]);
+    haptics.devicePos = glm::vec2(record.devicePos[0], record.devicePos[1]);
+    haptics.anchorPos = glm::vec2(record.anchorPos[0], record.anchorPos[1]);
+    haptics.smoothedResistance = record.smoothedResistance;
+    haptics.currentForce1D = record.currentForce1D;
+    haptics.rawInputVal = record.rawInputVal;
+    haptics.radius = record.radius;
+    haptics.frictionCoef = record.frictionCoef;
+    haptics.hapkitScale = record.hapkitScale;
+    haptics.springK = record.springK;
+    haptics.currentAxis = static_cast<HapticSystem::AxisMode>(record.axis);
+    haptics.currentMode = static_cast<HapticSystem::ControlMode>(record.mode);
+}
+
+// Each run is the packed cell byte followed by the run length as a LEB128 varint
+void EncodeRuns(const std::vector<PackedCell>& cells, std::vector<uint8_t>& out) {
+    size_t i = 0;
+    while (i < cells.size()) {
+        PackedCell value = cells[i];
+        size_t end = i + 1;
+        while (end < cells.size() && cells[end] == value) ++end;
+
+        out.push_back(value);
+        for (uint64_t run = end - i; ; run >>= 7) {
+            if (run < 0x80) {
+                out.push_back(static_cast<uint8_t>(run));
+                break;
+            }
+            out.push_back(static_cast<uint8_t>(run & 0x7F) | 0x80);
+        }
+        i = end;
+    }
+}
+
+// `out` must start zeroed: empty runs are skipped rather than written
+bool DecodeRuns(const uint8_t* in, size_t bytes, PackedCell* out, size_t count) {
+    size_t pos = 0;
+    size_t cell = 0;
+    while (pos < bytes) {
+        PackedCell value = in[pos++];
+        uint64_t run = 0;
+        for (int shift = 0; ; shift += 7) {
+            if (pos >= bytes || shift > 63) return false;
+            uint8_t byte = in[pos++];
+            run |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) break;
+        }
+        if (run > count - cell || !IsValidPackedCell(value)) return false;
+        if (value != 0) std::memset(out + cell, value, run);
+        cell += run;
+    }
+    return cell == count;
+}
+
+// Beds are settled dry sand from their top to the bottom row
+bool IsValidBeds(const std::vector<int32_t>& tops, const PackedCell* cells, int width, int height) {
+    for (int x = 0; x < width; ++x) {
+        if (tops[x] < 0 || tops[x] > height) return false;
+        for (int y = tops[x]; y < height; ++y) {
+            if (UnpackCell(cells[static_cast<size_t>(y) * width + x]).type != MaterialType::Sand) return false;
+        }
+    }
+    return true;
+}
+
+}
+
+bool SaveSnapshot(const std::string& path, const SandSimulation& sim, const HapticSystem* haptics,
+                  SnapshotEncoding encoding) {
+    std::vector<PackedCell> cells;
+    sim.ExportCells(cells);
+
+    std::vector<uint8_t> runs;
+    if (encoding == SnapshotEncoding::RunLength) EncodeRuns(cells, runs);
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.encoding = static_cast<uint32_t>(encoding);
+    header.width = sim.width;
+    header.height = sim.height;
+    header.seed = sim.seed;
+    header.tickCount = sim.GetTickCount();
+    header.occupiedCount = sim.GetOccupiedCount();
+    if (haptics) {
+        header.flags |= SNAPSHOT_HAS_HAPTICS;
+        header.haptics = CaptureHaptics(*haptics);
+    }
+    std::vector<int32_t> bedTops;
+    std::vector<uint8_t> bedFlags;
+    if (sim.GetBedColumnCount() > 0) {
+        header.flags |= SNAPSHOT_HAS_BEDS;
+        sim.ExportBeds(bedTops, bedFlags);
+    }
+
+    const uint8_t* payload = runs.data();
+    header.cellOffset = sizeof(SnapshotHeader);
+    header.cellBytes = runs.size();
+    if (encoding == SnapshotEncoding::Raw) {
+        payload = cells.data();
+        header.cellOffset = (sizeof(SnapshotHeader) + SNAPSHOT_CELL_ALIGN - 1) / SNAPSHOT_CELL_ALIGN * SNAPSHOT_CELL_ALIGN;
+        header.cellBytes = cells.size();
+    }
+    if (header.flags & SNAPSHOT_HAS_BEDS) {
+        header.bedOffset = header.cellOffset + header.cellBytes;
+        header.bedBytes = bedTops.size() * SNAPSHOT_BED_COLUMN_BYTES;
+    }
+
+    std::string tempPath = path + ".tmp";
+    FILE* file = std::fopen(tempPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "[Error] SaveSnapshot: cannot create " << tempPath << std::endl;
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fseek(file, static_cast<long>(header.cellOffset), SEEK_SET) == 0 &&
+              std::fwrite(payload, 1, header.cellBytes, file) == header.cellBytes &&
+              std::fwrite(bedTops.data(), sizeof(int32_t), bedTops.size(), file) == bedTops.size() &&
+              std::fwrite(bedFlags.data(), 1, bedFlags.size(), file) == bedFlags.size();
+    ok = std::fclose(file) == 0 && ok;
+
+    if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "[Error] SaveSnapshot: cannot write " << path << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LoadSnapshot(const std::string& path, SandSimulation& sim, HapticSystem* haptics) {
+    MappedRegion region;
+    if (!region.MapFileCopy(path)) return false;
+
+    SnapshotHeader header{};
+    if (region.Bytes() < sizeof(header)) {
+        std::cerr << "[Error] LoadSnapshot: " << path << " is truncated" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, region.Data(), sizeof(header));
+
+    size_t cellCount = static_cast<size_t>(header.width) * static_cast<size_t>(header.height);
+    auto encoding = static_cast<SnapshotEncoding>(header.encoding);
+    bool valid = std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+                 header.version == SNAPSHOT_VERSION && header.encoding < static_cast<uint32_t>(SnapshotEncoding::Count) &&
+                 header.width > 0 && header.height > 0 && header.width <= SNAPSHOT_MAX_SIDE &&
+                 header.height <= SNAPSHOT_MAX_SIDE && cellCount <= SNAPSHOT_MAX_CELLS &&
+                 header.cellOffset <= region.Bytes() &&
+                 header.cellBytes <= region.Bytes() - header.cellOffset &&
+                 (encoding != SnapshotEncoding::Raw || header.cellBytes == cellCount) &&
+                 (!(header.flags & SNAPSHOT_HAS_BEDS) ||
+                  (header.bedBytes == static_cast<size_t>(header.width) * SNAPSHOT_BED_COLUMN_BYTES &&
+                   header.bedOffset <= region.Bytes() && header.bedBytes <= region.Bytes() - header.bedOffset));
+    if (!valid) {
+        std::cerr << "[Error] LoadSnapshot: " << path << " is not a valid version " << SNAPSHOT_VERSION << " snapshot"
+                  << std::endl;
+        return false;
+    }
+
+    // Copied out before a raw snapshot's mapping moves into the cell buffer
+    std::vector<int32_t> bedTops;
+    std::vector<uint8_t> bedFlags;
+    if (header.flags & SNAPSHOT_HAS_BEDS) {
+        const uint8_t* beds = static_cast<const uint8_t*>(region.Data()) + header.bedOffset;
+        bedTops.resize(header.width);
+        std::memcpy(bedTops.data(), beds, bedTops.size() * sizeof(int32_t));
+        bedFlags.assign(beds + bedTops.size() * sizeof(int32_t), beds + header.bedBytes);
+    }
+
+    CellBuffer<PackedCell> cells;
+    if (encoding == SnapshotEncoding::Raw) {
+        const PackedCell* raw = static_cast<const PackedCell*>(region.Data()) + header.cellOffset;
+        if (!std::all_of(raw, raw + cellCount, IsValidPackedCell)) {
+            std::cerr << "[Error] LoadSnapshot: " << path << " holds unknown cells" << std::endl;
+            return false;
+        }
+        cells.Adopt(std::move(region), cellCount, header.cellOffset);
+    } else {
+        cells.Assign(cellCount, 0);
+        const uint8_t* runs = static_cast<const uint8_t*>(region.Data()) + header.cellOffset;
+        if (!DecodeRuns(runs, header.cellBytes, cells.Data(), cellCount)) {
+            std::cerr << "[Error] LoadSnapshot: " << path << " has corrupt cell runs" << std::endl;
+            return false;
+        }
+    }
+
+    if (!bedTops.empty() && !IsValidBeds(bedTops, cells.Data(), header.width, header.height)) {
+        std::cerr << "[Error] LoadSnapshot: " << path << " has beds over anything but dry sand" << std::endl;
+        return false;
+    }
+
+    sim.seed = header.seed;
+    // The header's occupied count is informational; LoadCells counts the cells itself
+    sim.LoadCells(header.width, header.height, std::move(cells));
+    sim.SetTickCount(header.tickCount);
+    if (!bedTops.empty()) sim.LoadBeds(bedTops, bedFlags);
+    if (haptics && (header.flags & SNAPSHOT_HAS_HAPTICS)) RestoreHaptics(header.haptics, *haptics);
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+class HapticSystem;
+class SandSimulation;
+
+// --- Snapshot Files ---
+// Versioned binary save of a simulation: the grid, the RNG state (seed and tick), any
+// heightfield beds and, optionally, the haptic state. Cells are either run-length encoded by material and
+// soak, or stored raw as page-aligned row-major packed bytes that loading maps straight
+// into the simulation after one validating pass, without copying them.
+
+enum class SnapshotEncoding : uint32_t {
+    RunLength,
+    Raw,
+    Count
+};
+
+// Writes through a temporary file and renames it into place, so a world that is still
+// mapped from an older snapshot at the same path keeps its data
+bool SaveSnapshot(const std::string& path, const SandSimulation& sim, const HapticSystem* haptics,
+                  SnapshotEncoding encoding = SnapshotEncoding::RunLength);
+
+// Haptic state is restored only when the snapshot has it and `haptics` is given
+bool LoadSnapshot(const std::string& path, SandSimulation& sim, HapticSystem* haptics);
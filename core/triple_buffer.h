@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// --- Triple Buffer ---
+// Lock-free single-producer/single-consumer hand-off of the latest value. The writer
+// fills Back() and publishes it; the reader swaps in the newest published buffer, if
+// any, and keeps reading Front() until it asks again. Neither side ever waits.
+template <typename T>
+class TripleBuffer {
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH_BIT = 0x4;
+
+    T m_buffers[3];
+    // Index of the middle buffer, plus FRESH_BIT while it holds an unread publish
+    std::atomic<uint8_t> m_middle{1};
+    uint8_t m_back = 0;   // Writer-owned
+    uint8_t m_front = 2;  // Reader-owned
+
+public:
+    T& Back() { return m_buffers[m_back]; }
+
+    void Publish() {
+        uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_back | FRESH_BIT), std::memory_order_acq_rel);
+        m_back = previous & INDEX_MASK;
+    }
+
+    // Returns true when a newer buffer was swapped into Front()
+    bool Acquire() {
+        if ((m_middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0) return false;
+        uint8_t previous = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& Front() const { return m_buffers[m_front]; }
+};
@@ -0,0 +1,67 @@
+#include "core/worker_pool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threadCount) {
+    for (int i = 1; i < std::max(1, threadCount); ++i) {
+        m_threads.emplace_back(&WorkerPool::WorkerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& thread : m_threads) thread.join();
+}
+
+void WorkerPool::ParallelFor(int count, const std::function<void(int, int)>& fn) {
+    if (count <= 0) return;
+    if (m_threads.empty() || count == 1) {
+        for (int i = 0; i < count; ++i) fn(i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &fn;
+        m_jobCount = count;
+        m_nextItem.store(0, std::memory_order_relaxed);
+        m_busyWorkers = static_cast<int>(m_threads.size());
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    RunItems(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+    m_job = nullptr;
+}
+
+void WorkerPool::RunItems(int workerIndex) {
+    for (;;) {
+        int item = m_nextItem.fetch_add(1, std::memory_order_relaxed);
+        if (item >= m_jobCount) return;
+        (*m_job)(item, workerIndex);
+    }
+}
+
+void WorkerPool::WorkerLoop(int workerIndex) {
+    unsigned seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+            if (m_stopping) return;
+            seenGeneration = m_generation;
+        }
+
+        RunItems(workerIndex);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0) m_done.notify_one();
+    }
+}
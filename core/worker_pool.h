@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --- Worker Pool ---
+// Fixed set of threads for fork-join loops. The calling thread takes part as worker 0.
+class WorkerPool {
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    const std::function<void(int, int)>* m_job = nullptr;
+    int m_jobCount = 0;
+    std::atomic<int> m_nextItem{0};
+    int m_busyWorkers = 0;
+    unsigned m_generation = 0;
+    bool m_stopping = false;
+
+    void WorkerLoop(int workerIndex);
+    void RunItems(int workerIndex);
+
+public:
+    explicit WorkerPool(int threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    [[nodiscard]] int GetThreadCount() const { return static_cast<int>(m_threads.size()) + 1; }
+
+    // Calls fn(item, workerIndex) for every item in [0, count) and returns once all are done
+    void ParallelFor(int count, const std::function<void(int, int)>& fn);
+};
@@ -7,472 +7,44 @@
 
 // Standard Library
 #include <algorithm>
-#include <cmath>
-#include <cstdlib>
-#include <iomanip>
-#include <iostream>
-#include <memory>
-#include <sstream>
+#include <cstdio>
 #include <string>
-#include <vector>
-
-// Serial Library
-#include <serial/serial.h>
+#include <thread>
 
 // GLM
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-
-// --- Constants ---
-constexpr int INITIAL_WIDTH = 60;
-constexpr int INITIAL_HEIGHT = 60;
-constexpr int SOAK_THRESHOLD = 2;
-constexpr float TICK_DELAY_DEFAULT = 16.0f;
-
-// --- Types ---
-enum class MaterialType {
-    Empty = 0,
-    Sand,
-    WetSand,
-    Water,
-    Count
-};
-
-struct Cell {
-    MaterialType type = MaterialType::Empty;
-    int soak = 0;
-};
-
-// --- Haptic Device Communication Class ---
-class HapticDevice {
-private:
-    std::unique_ptr<serial::Serial> m_serial;
-    float m_currentPositionMeters = 0.0f;
-    float m_lastSentForce = -999.0f;
-    double m_lastSendTime = 0.0;
-
-public:
-    std::string port = "/dev/ttyUSB0";
-    unsigned long baud = 115200;
-    bool connected = false;
-
-    HapticDevice() = default;
-    ~HapticDevice() { Disconnect(); }
-
-    // Disable copying
-    HapticDevice(const HapticDevice&) = delete;
-    HapticDevice& operator=(const HapticDevice&) = delete;
-
-    bool Connect() {
-        try {
-            // Timeout(0) = Non-blocking
-            m_serial = std::make_unique<serial::Serial>(port, baud, serial::Timeout::simpleTimeout(0));
-
-            if (m_serial->isOpen()) {
-                connected = true;
-                m_currentPositionMeters = 0.0f;
-                m_serial->flushInput();
-                return true;
-            }
-            return false;
-        } catch (const std::exception& e) {
-            std::cerr << "[Error] Connect: " << e.what() << std::endl;
-            return false;
-        }
-    }
-
-    void Disconnect() {
-        if (m_serial && m_serial->isOpen()) {
-            try {
-                m_serial->write("F 0.0\n");
-                m_serial->close();
-            } catch (...) {}
-        }
-        m_serial.reset();
-        connected = false;
-    }
-
-    void Sync(float forceOutputNewtons) {
-        if (!connected || !m_serial) return;
-
-        // Read available data
-        int maxReads = 50;
-        try {
-            while (m_serial->available() && maxReads-- > 0) {
-                std::string line = m_serial->readline();
-                if (line.length() > 4 && line.back() == '\n') {
-                    if (line[0] == 'P') {
-                        try {
-                            m_currentPositionMeters = std::stof(line.substr(2));
-                        } catch (...) {}
-                    }
-                }
-            }
-        } catch (...) {}
-
-        // Write force data (rate limited or change threshold)
-        double currentTime = glfwGetTime();
-        if (std::abs(forceOutputNewtons - m_lastSentForce) > 0.005f || (currentTime - m_lastSendTime) > 0.05) {
-            std::stringstream ss;
-            ss << std::fixed << std::setprecision(5) << "F " << forceOutputNewtons << "\n";
-            try {
-                m_serial->write(ss.str());
-                m_lastSentForce = forceOutputNewtons;
-                m_lastSendTime = currentTime;
-            } catch (...) {}
-        }
-    }
-
-    [[nodiscard]] float GetPositionMeters() const {
-        return m_currentPositionMeters;
-    }
-};
 
-// --- Sand Simulation ---
-class SandSimulation {
-private:
-    std::vector<Cell> m_grid;
-    Cell m_boundaryCell = { MaterialType::Sand, 0 };
-
-    [[nodiscard]] bool IsInBounds(int x, int y) const {
-        return x >= 0 && x < width && y >= 0 && y < height;
-    }
-
-    [[nodiscard]] int GetIndex(int x, int y) const {
-        return y * width + x;
-    }
-
-public:
-    int width = INITIAL_WIDTH;
-    int height = INITIAL_HEIGHT;
-    float tickDelayMs = TICK_DELAY_DEFAULT;
-
-    SandSimulation() { Resize(width, height); }
-
-    void Resize(int w, int h) {
-        width = w;
-        height = h;
-        m_grid.assign(width * height, { MaterialType::Empty });
-    }
-
-    void Clear() {
-        std::fill(m_grid.begin(), m_grid.end(), Cell{ MaterialType::Empty });
-    }
-
-    [[nodiscard]] Cell Get(int x, int y) const {
-        if (!IsInBounds(x, y)) return m_boundaryCell;
-        return m_grid[GetIndex(x, y)];
-    }
-
-    void Set(int x, int y, MaterialType type, int soak = 0) {
-        if (IsInBounds(x, y)) {
-            m_grid[GetIndex(x, y)] = {type, soak};
-        }
-    }
-
-    bool Move(int x1, int y1, int x2, int y2) {
-        if (!IsInBounds(x1, y1) || !IsInBounds(x2, y2)) return false;
-
-        int idx2 = GetIndex(x2, y2);
-        if (m_grid[idx2].type != MaterialType::Empty) return false;
-
-        int idx1 = GetIndex(x1, y1);
-        m_grid[idx2] = m_grid[idx1];
-        m_grid[idx1] = {MaterialType::Empty, 0};
-        return true;
-    }
-
-    bool Swap(int x1, int y1, int x2, int y2) {
-        if (!IsInBounds(x1, y1) || !IsInBounds(x2, y2)) return false;
-        std::swap(m_grid[GetIndex(x1, y1)], m_grid[GetIndex(x2, y2)]);
-        return true;
-    }
-
-    [[nodiscard]] float GetResistance(float cx, float cy, float radius) const {
-        float totalResistance = 0.0f;
-        float r2 = radius * radius;
-
-        int minX = static_cast<int>(std::floor(cx - radius));
-        int maxX = static_cast<int>(std::ceil(cx + radius));
-        int minY = static_cast<int>(std::floor(cy - radius));
-        int maxY = static_cast<int>(std::ceil(cy + radius));
-
-        for (int y = minY; y <= maxY; ++y) {
-            for (int x = minX; x <= maxX; ++x) {
-                if (!IsInBounds(x, y)) continue;
-
-                float dx = static_cast<float>(x) - cx;
-                float dy = static_cast<float>(y) - cy;
-
-                if (dx*dx + dy*dy <= r2) {
-                    Cell cell = Get(x, y);
-                    if (cell.type == MaterialType::Sand) {
-                        totalResistance += 0.1f;
-                    } else if (cell.type == MaterialType::WetSand) {
-                        totalResistance += cell.soak * 0.02f + 0.1f;
-                    } else if (cell.type == MaterialType::Water) {
-                        totalResistance += 0.02f;
-                    }
-                }
-            }
-        }
-        return totalResistance;
-    }
-
-    [[nodiscard]] glm::ivec2 FindNearestEmpty(int targetX, int targetY, int maxRadius) const {
-        if (IsInBounds(targetX, targetY) && Get(targetX, targetY).type == MaterialType::Empty) {
-            return glm::ivec2(targetX, targetY);
-        }
-        for (int r = 1; r <= maxRadius; ++r) {
-            for (int dy = -r; dy <= r; ++dy) {
-                for (int dx = -r; dx <= r; ++dx) {
-                    if (std::abs(dx) != r && std::abs(dy) != r) continue;
-
-                    int nx = targetX + dx;
-                    int ny = targetY + dy;
-                    if (IsInBounds(nx, ny) && Get(nx, ny).type == MaterialType::Empty) {
-                        return glm::ivec2(nx, ny);
-                    }
-                }
-            }
-        }
-        return glm::ivec2(-1, -1);
-    }
-
-    void Update() {
-        for (int y = height - 1; y >= 0; --y) {
-            for (int x = 0; x < width; ++x) {
-                MaterialType type = m_grid[y * width + x].type;
-                switch (type) {
-                    case MaterialType::Sand:    UpdateSand(x, y); break;
-                    case MaterialType::WetSand: UpdateWetSand(x, y); break;
-                    case MaterialType::Water:   UpdateWater(x, y); break;
-                    default: break;
-                }
-            }
-        }
-    }
-
-private:
-    void UpdateSand(int x, int y) {
-        if (y + 1 >= height) return;
-
-        MaterialType below = Get(x, y + 1).type;
-        if (below == MaterialType::Water) { Swap(x, y, x, y + 1); return; }
-        if (below == MaterialType::Empty) { Move(x, y, x, y + 1); return; }
-
-        bool leftEmpty = (x - 1 >= 0) && Get(x - 1, y + 1).type == MaterialType::Empty;
-        bool rightEmpty = (x + 1 < width) && Get(x + 1, y + 1).type == MaterialType::Empty;
-
-        if (leftEmpty && rightEmpty) {
-            int offset = (rand() % 2 == 0) ? -1 : 1;
-            Move(x, y, x + offset, y + 1);
-        } else if (leftEmpty) {
-            Move(x, y, x - 1, y + 1);
-        } else if (rightEmpty) {
-            Move(x, y, x + 1, y + 1);
-        }
-    }
-
-    void UpdateWetSand(int x, int y) {
-        if (y + 1 >= height) return;
-
-        MaterialType below = Get(x, y + 1).type;
-        if (below == MaterialType::Empty) { Move(x, y, x, y + 1); return; }
-        if (below == MaterialType::Water) { Swap(x, y, x, y + 1); return; }
-    }
-
-    void UpdateWater(int x, int y) {
-        if (TryWetSand(x, y)) return;
-
-        if (y + 1 < height && Get(x, y + 1).type == MaterialType::Empty) {
-            Move(x, y, x, y + 1);
-        } else if (y + 1 < height) {
-            bool left = (x - 1 >= 0) && Get(x - 1, y + 1).type == MaterialType::Empty;
-            bool right = (x + 1 < width) && Get(x + 1, y + 1).type == MaterialType::Empty;
-
-            if (left && right) Move(x, y, (rand() % 2 == 0) ? x - 1 : x + 1, y + 1);
-            else if (left) Move(x, y, x - 1, y + 1);
-            else if (right) Move(x, y, x + 1, y + 1);
-            else {
-                bool lSide = (x - 1 >= 0) && Get(x - 1, y).type == MaterialType::Empty;
-                bool rSide = (x + 1 < width) && Get(x + 1, y).type == MaterialType::Empty;
-
-                if (lSide && rSide) Move(x, y, (rand() % 2 == 0) ? x - 1 : x + 1, y);
-                else if (lSide) Move(x, y, x - 1, y);
-                else if (rSide) Move(x, y, x + 1, y);
-            }
-        }
-    }
-
-    bool TryWetSand(int wx, int wy) {
-        static const int offsets[9][2] = {{0, 1}, {1, 0}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {1, -1}, {-1, -1}, {0, 2}};
-        for (const auto& o : offsets) {
-            int sx = wx + o[0];
-            int sy = wy + o[1];
-
-            if (!IsInBounds(sx, sy)) continue;
-
-            Cell cell = Get(sx, sy);
-            if (cell.type == MaterialType::Sand) {
-                Set(sx, sy, MaterialType::WetSand, 1);
-                Set(wx, wy, MaterialType::Empty, 0);
-                return true;
-            }
-            if (cell.type == MaterialType::WetSand && cell.soak < SOAK_THRESHOLD) {
-                Set(sx, sy, MaterialType::WetSand, cell.soak + 1);
-                Set(wx, wy, MaterialType::Empty, 0);
-                return true;
-            }
-            if (cell.type == MaterialType::WetSand && cell.soak >= SOAK_THRESHOLD && sy < wy) {
-                Swap(wx, wy, sx, sy);
-                return true;
-            }
-        }
-        return false;
-    }
-};
-
-// --- Haptic System ---
-class HapticSystem {
-public:
-    enum class AxisMode { X_Axis, Y_Axis };
-    enum class ControlMode { Mode_1DOF, Mode_2DOF };
-
-    // State
-    glm::vec2 proxyPos  = { 30.0f, 30.0f };
-    glm::vec2 devicePos = { 30.0f, 30.0f };
-    glm::vec2 anchorPos = { 30.0f, 30.0f };
-    float smoothedResistance = 0.0f;
-    float currentForce1D = 0.0f;
-    float rawInputVal = 0.0f;
-
-    // Configuration
-    AxisMode  currentAxis = AxisMode::X_Axis;
-    ControlMode currentMode = ControlMode::Mode_1DOF;
-    float radius = 4.0f;
-    float frictionCoef = 5.0f;
-    float hapkitScale = 500.0f;
-    float springK = 0.5f;
-
-    void Recenter(const glm::vec2& newCenter) {
-        anchorPos = newCenter;
-        proxyPos = newCenter;
-        devicePos = newCenter;
-        rawInputVal = 0.0f;
-    }
-
-    void Update(const glm::vec2& mousePos, float rawInputMeters, bool isMouseInput, SandSimulation& sim) {
-        if (currentMode == ControlMode::Mode_2DOF) {
-            devicePos = mousePos;
-            currentForce1D = 0.0f;
+// Core
+#include "core/bitboard_kernel.h"
+#include "core/cell.h"
+#include "core/material.h"
+#include "core/haptic_system.h"
+#include "core/simulation_thread.h"
+
+void RenderHaptics(const HapticSystem& haptics, ImDrawList* draw_list, ImVec2 origin, float cellSize) {
+    ImVec2 sDev = ImVec2(origin.x + haptics.devicePos.x * cellSize, origin.y + haptics.devicePos.y * cellSize);
+    ImVec2 sProx = ImVec2(origin.x + haptics.proxyPos.x * cellSize, origin.y + haptics.proxyPos.y * cellSize);
+    ImVec2 sAnch = ImVec2(origin.x + haptics.anchorPos.x * cellSize, origin.y + haptics.anchorPos.y * cellSize);
+
+    if (haptics.currentMode == HapticSystem::ControlMode::Mode_1DOF) {
+        ImU32 railColor = IM_COL32(100, 100, 100, 100);
+        float railLen = 2000.0f;
+        if (haptics.currentAxis == HapticSystem::AxisMode::X_Axis) {
+            draw_list->AddLine(ImVec2(sAnch.x - railLen, sAnch.y), ImVec2(sAnch.x + railLen, sAnch.y), railColor, 1.0f);
         } else {
-            if (isMouseInput) {
-                if (currentAxis == AxisMode::X_Axis) {
-                    rawInputVal = (mousePos.x - anchorPos.x) / hapkitScale;
-                } else {
-                    rawInputVal = (mousePos.y - anchorPos.y) / hapkitScale;
-                }
-            } else {
-                rawInputVal = rawInputMeters;
-            }
-
-            // Clamping
-            rawInputVal = std::max(-0.08f, std::min(0.08f, rawInputVal));
-
-            if (currentAxis == AxisMode::X_Axis) {
-                devicePos = glm::vec2(anchorPos.x + rawInputVal * hapkitScale, anchorPos.y);
-            } else {
-                devicePos = glm::vec2(anchorPos.x, anchorPos.y + rawInputVal * hapkitScale);
-            }
-        }
-
-        // Low Pass Filter on Resistance
-        float rawResistance = sim.GetResistance(proxyPos.x, proxyPos.y, radius);
-        constexpr float alpha = 0.2f;
-        smoothedResistance = smoothedResistance * (1.0f - alpha) + rawResistance * alpha;
-
-        float viscosity = 1.0f / (1.0f + (smoothedResistance * frictionCoef));
-
-        // Move Proxy
-        glm::vec2 diff = devicePos - proxyPos;
-        proxyPos += diff * viscosity;
-
-        DisplaceSand(sim);
-
-        // Force Calculation (Spring)
-        glm::vec2 forceVec = (proxyPos - devicePos) * -springK;
-
-        if (glm::length(forceVec) < 0.025f) forceVec = glm::vec2(0.0f);
-
-        if (currentMode == ControlMode::Mode_1DOF) {
-            currentForce1D = (currentAxis == AxisMode::X_Axis) ? forceVec.x : forceVec.y;
+            draw_list->AddLine(ImVec2(sAnch.x, sAnch.y - railLen), ImVec2(sAnch.x, sAnch.y + railLen), railColor, 1.0f);
         }
+        draw_list->AddCircleFilled(sAnch, 4.0f, IM_COL32(255, 255, 0, 200));
     }
 
-    void Render(ImDrawList* draw_list, ImVec2 origin, float cellSize) const {
-        ImVec2 sDev = ImVec2(origin.x + devicePos.x * cellSize, origin.y + devicePos.y * cellSize);
-        ImVec2 sProx = ImVec2(origin.x + proxyPos.x * cellSize, origin.y + proxyPos.y * cellSize);
-        ImVec2 sAnch = ImVec2(origin.x + anchorPos.x * cellSize, origin.y + anchorPos.y * cellSize);
-
-        if (currentMode == ControlMode::Mode_1DOF) {
-            ImU32 railColor = IM_COL32(100, 100, 100, 100);
-            float railLen = 2000.0f;
-            if (currentAxis == AxisMode::X_Axis) {
-                draw_list->AddLine(ImVec2(sAnch.x - railLen, sAnch.y), ImVec2(sAnch.x + railLen, sAnch.y), railColor, 1.0f);
-            } else {
-                draw_list->AddLine(ImVec2(sAnch.x, sAnch.y - railLen), ImVec2(sAnch.x, sAnch.y + railLen), railColor, 1.0f);
-            }
-            draw_list->AddCircleFilled(sAnch, 4.0f, IM_COL32(255, 255, 0, 200));
-        }
-
-        draw_list->AddCircleFilled(sProx, radius * cellSize, IM_COL32(255, 50, 50, 200));
-        draw_list->AddCircle(sDev, radius * cellSize, IM_COL32(50, 255, 50, 200), 0, 2.0f);
-        draw_list->AddLine(sDev, sProx, IM_COL32(50, 100, 255, 255), 2.0f);
-    }
-
-private:
-    void DisplaceSand(SandSimulation& sim) {
-        int r = static_cast<int>(std::ceil(radius));
-        int px = static_cast<int>(proxyPos.x);
-        int py = static_cast<int>(proxyPos.y);
-        float rSq = radius * radius;
-
-        for (int y = py - r; y <= py + r; ++y) {
-            for (int x = px - r; x <= px + r; ++x) {
-                if (sim.Get(x, y).type != MaterialType::Empty) {
-                    float dx = static_cast<float>(x) - proxyPos.x;
-                    float dy = static_cast<float>(y) - proxyPos.y;
-
-                    if (dx*dx + dy*dy <= rSq) {
-                        glm::vec2 dir(dx, dy);
-                        if (glm::length(dir) < 0.01f) dir = glm::vec2(0, -1);
-                        else dir = glm::normalize(dir);
-
-                        glm::vec2 target = proxyPos + dir * (radius + 1.5f);
-                        glm::ivec2 best = sim.FindNearestEmpty(static_cast<int>(target.x), static_cast<int>(target.y), 3);
-                        if (best.x != -1) sim.Move(x, y, best.x, best.y);
-                    }
-                }
-            }
-        }
-    }
-};
+    draw_list->AddCircleFilled(sProx, haptics.radius * cellSize, IM_COL32(255, 50, 50, 200));
+    draw_list->AddCircle(sDev, haptics.radius * cellSize, IM_COL32(50, 255, 50, 200), 0, 2.0f);
+    draw_list->AddLine(sDev, sProx, IM_COL32(50, 100, 255, 255), 2.0f);
+}
 
 ImU32 GetColor(const Cell& cell) {
-    switch (cell.type) {
-        case MaterialType::Sand:
-            return IM_COL32(235, 200, 100, 255);
-        case MaterialType::WetSand:
-            return (cell.soak >= SOAK_THRESHOLD)
-                   ? IM_COL32(100, 80, 40, 255)
-                   : IM_COL32(160, 130, 70, 255);
-        case MaterialType::Water:
-            return IM_COL32(0, 120, 255, 200);
-        case MaterialType::Empty:
-        default:
-            return IM_COL32(0, 0, 0, 0);
-    }
+    MaterialColor color = GetCellColor(cell);
+    return IM_COL32(color.r, color.g, color.b, color.a);
 }
 
 int main() {
@@ -495,22 +67,38 @@ int main() {
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
-    SandSimulation sim;
-    HapticSystem haptics;
-    HapticDevice device;
+    SimulationThread simThread;
+    SimSettings settings = simThread.GetSettings();
+    simThread.Start();
 
     int currentMaterialIdx = static_cast<int>(MaterialType::Sand);
     char portBuffer[64] = "/dev/ttyUSB0";
-    float timeAccumulator = 0.0f;
+    char snapshotPath[256] = "sandsim.snap";
+    bool saveRaw = false;
+    char journalPath[256] = "sandsim.jrnl";
     bool simulateInput = true;
+    bool wasConnected = false;
+    bool showChunks = false;
+    int checkpointIdx = 0;
+    float brushRadius = 0.5f;
+    bool wasPainting = false;
+    glm::vec2 lastPaintPos(0.0f);
+    int maxThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
 
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
 
-        timeAccumulator += ImGui::GetIO().DeltaTime * 1000.0f;
-        if (timeAccumulator >= sim.tickDelayMs) {
-            sim.Update();
-            timeAccumulator = 0.0f;
+        // Latest published frame; never blocks on the simulation thread
+        const SimSnapshot& frame = simThread.AcquireSnapshot();
+        const HapticSystem& haptics = frame.haptics;
+
+        // Pick up settings the simulation thread replaced, e.g. from a loaded snapshot
+        if (frame.settingsRevision != settings.revision) settings = simThread.GetSettings();
+
+        // Switch input source when the device (dis)connects
+        if (frame.deviceConnected != wasConnected) {
+            simulateInput = !frame.deviceConnected;
+            wasConnected = frame.deviceConnected;
         }
 
         ImGui_ImplOpenGL3_NewFrame();
@@ -524,69 +112,146 @@ int main() {
         ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
         ImGui::Begin("Controls");
 
-        ImGui::SliderFloat("Sim Speed (ms)", &sim.tickDelayMs, 1.0f, 200.0f);
+        ImGui::SliderFloat("Sim Speed (ms)", &settings.tickDelayMs, 0.01f, 200.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderFloat("Speed x", &settings.speedMultiplier, 0.1f, 10.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderFloat("Max Catch-Up (ms)", &settings.maxCatchUpMs, 0.0f, 1000.0f);
+        ImGui::Text("Ticks/s: %.0f (target %.0f)", frame.ticksPerSecond,
+                    1000.0f / settings.tickDelayMs * settings.speedMultiplier);
+        ImGui::Checkbox("Chunk Sleeping", &settings.chunkSleeping);
+        ImGui::SameLine();
+        ImGui::Checkbox("Show Chunks", &showChunks);
+        ImGui::SliderInt("Threads", &settings.threadCount, 1, maxThreads);
+        const char* engineNames[] = { "Scan", "Bitboard", "Margolus" };
+        int engineIdx = static_cast<int>(settings.engine);
+        if (ImGui::Combo("Engine", &engineIdx, engineNames, IM_ARRAYSIZE(engineNames))) {
+            settings.engine = static_cast<UpdateEngine>(engineIdx);
+        }
+        const char* worklistNames[] = { "Auto", "Dense", "Sparse" };
+        int worklistIdx = static_cast<int>(settings.worklistMode);
+        if (ImGui::Combo("Worklist", &worklistIdx, worklistNames, IM_ARRAYSIZE(worklistNames))) {
+            settings.worklistMode = static_cast<WorklistMode>(worklistIdx);
+        }
+        const char* waterNames[] = { "Cellular", "Hydrostatic" };
+        int waterIdx = static_cast<int>(settings.waterMode);
+        if (ImGui::Combo("Water", &waterIdx, waterNames, IM_ARRAYSIZE(waterNames))) {
+            settings.waterMode = static_cast<WaterMode>(waterIdx);
+        }
+        const char* layoutNames[] = { "Row-Major", "Tiled 8x8", "Chunked 32x32", "Z-Order 32x32" };
+        int layoutIdx = static_cast<int>(settings.layout);
+        if (ImGui::Combo("Layout", &layoutIdx, layoutNames, IM_ARRAYSIZE(layoutNames))) {
+            settings.layout = static_cast<GridLayout>(layoutIdx);
+        }
+        ImGui::Checkbox("Multi-Resolution", &settings.multiResolution);
+        ImGui::Checkbox("Heightfield Beds", &settings.heightfield);
+        if (settings.heightfield) ImGui::Text("Bed columns: %d/%d", frame.bedColumnCount, frame.width);
+        const char* backendNames[] = { "Cellular", "Particles (DEM)" };
+        int backendIdx = static_cast<int>(settings.backend);
+        if (ImGui::Combo("Backend", &backendIdx, backendNames, IM_ARRAYSIZE(backendNames))) {
+            settings.backend = static_cast<BackendType>(backendIdx);
+        }
+        ImGui::Text("Fill: %.2f%% (%s)", 100.0f * frame.occupiedCount / std::max(frame.width * frame.height, 1),
+                    frame.sparseActive ? "sparse" : "dense");
+        if (settings.backend == BackendType::Particles) ImGui::Text("Grains: %zu", frame.grainCount);
 
         ImGui::RadioButton("Dry", &currentMaterialIdx, static_cast<int>(MaterialType::Sand));
         ImGui::SameLine();
         ImGui::RadioButton("Wet", &currentMaterialIdx, static_cast<int>(MaterialType::WetSand));
         ImGui::SameLine();
         ImGui::RadioButton("H2O", &currentMaterialIdx, static_cast<int>(MaterialType::Water));
+        ImGui::SliderFloat("Brush", &brushRadius, 0.5f, 10.0f, "%.1f");
 
         ImGui::Separator();
         ImGui::Text("Haptic Device");
         ImGui::InputText("Port", portBuffer, 64);
 
-        if (ImGui::Button(device.connected ? "Disconnect" : "Connect")) {
-            if (device.connected) {
-                device.Disconnect();
-                simulateInput = true;
+        if (ImGui::Button(frame.deviceConnected ? "Disconnect" : "Connect")) {
+            if (frame.deviceConnected) {
+                simThread.Disconnect();
             } else {
-                device.port = std::string(portBuffer);
-                if (device.Connect()) {
-                    simulateInput = false;
-                }
+                simThread.Connect(std::string(portBuffer));
             }
         }
         ImGui::SameLine();
-        ImGui::TextColored(device.connected ? ImVec4(0,1,0,1) : ImVec4(1,0,0,1),
-                           device.connected ? "Connected" : "Disconnected");
+        ImGui::TextColored(frame.deviceConnected ? ImVec4(0,1,0,1) : ImVec4(1,0,0,1),
+                           frame.deviceConnected ? "Connected" : "Disconnected");
 
         ImGui::Separator();
         ImGui::Text("Control Mode");
 
-        if (ImGui::RadioButton("1D (Hapkit/Rail)", haptics.currentMode == HapticSystem::ControlMode::Mode_1DOF))
-            haptics.currentMode = HapticSystem::ControlMode::Mode_1DOF;
+        if (ImGui::RadioButton("1D (Hapkit/Rail)", settings.mode == HapticSystem::ControlMode::Mode_1DOF))
+            settings.mode = HapticSystem::ControlMode::Mode_1DOF;
         ImGui::SameLine();
-        if (ImGui::RadioButton("2D (Mouse/Free)", haptics.currentMode == HapticSystem::ControlMode::Mode_2DOF))
-            haptics.currentMode = HapticSystem::ControlMode::Mode_2DOF;
+        if (ImGui::RadioButton("2D (Mouse/Free)", settings.mode == HapticSystem::ControlMode::Mode_2DOF))
+            settings.mode = HapticSystem::ControlMode::Mode_2DOF;
 
-        if (haptics.currentMode == HapticSystem::ControlMode::Mode_1DOF) {
+        if (settings.mode == HapticSystem::ControlMode::Mode_1DOF) {
             ImGui::Text("Rail Axis:");
-            if (ImGui::RadioButton("X-Axis", haptics.currentAxis == HapticSystem::AxisMode::X_Axis))
-                haptics.currentAxis = HapticSystem::AxisMode::X_Axis;
+            if (ImGui::RadioButton("X-Axis", settings.axis == HapticSystem::AxisMode::X_Axis))
+                settings.axis = HapticSystem::AxisMode::X_Axis;
             ImGui::SameLine();
-            if (ImGui::RadioButton("Y-Axis", haptics.currentAxis == HapticSystem::AxisMode::Y_Axis))
-                haptics.currentAxis = HapticSystem::AxisMode::Y_Axis;
+            if (ImGui::RadioButton("Y-Axis", settings.axis == HapticSystem::AxisMode::Y_Axis))
+                settings.axis = HapticSystem::AxisMode::Y_Axis;
 
-            ImGui::SliderFloat("Scale (Pix/m)", &haptics.hapkitScale, 100.0f, 2000.0f);
+            ImGui::SliderFloat("Scale (Pix/m)", &settings.hapkitScale, 100.0f, 2000.0f);
             ImGui::Text("Input (m): %.4f", haptics.rawInputVal);
             ImGui::Text("Output (N): %.2f", haptics.currentForce1D);
         }
 
         ImGui::Separator();
-        ImGui::SliderFloat("Stiffness (k)", &haptics.springK, 0.001f, 5.0f);
-        ImGui::SliderFloat("Radius", &haptics.radius, 1.0f, 10.0f);
-        ImGui::SliderFloat("Friction", &haptics.frictionCoef, 0.01f, 10.0f);
+        ImGui::SliderFloat("Stiffness (k)", &settings.springK, 0.001f, 5.0f);
+        ImGui::SliderFloat("Radius", &settings.radius, 1.0f, 10.0f);
+        ImGui::SliderFloat("Friction", &settings.frictionCoef, 0.01f, 10.0f);
         ImGui::Text("Smooth Res: %.2f", haptics.smoothedResistance);
+        ImGui::Checkbox("High-Rate Region", &settings.highRateRegion);
+        if (settings.highRateRegion) {
+            ImGui::SliderFloat("Region (radii)", &settings.regionRadii, 1.0f, 16.0f);
+            ImGui::SliderFloat("Region Rate (Hz)", &settings.regionRateHz, 100.0f, 4000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+            ImGui::Text("Region ticks/s: %.0f", frame.regionTicksPerSecond);
+        }
 
         ImGui::Separator();
         ImGui::Text("Press 'G' to Re-Center Anchor");
         ImGui::Checkbox("Drive w/ Mouse", &simulateInput);
 
-        if (ImGui::Button("Reset Sand")) sim.Clear();
+        if (ImGui::Button("Reset Sand")) simThread.Clear();
+
+        ImGui::InputText("Snapshot", snapshotPath, sizeof(snapshotPath));
+        if (ImGui::Button("Save")) {
+            simThread.Save(snapshotPath, saveRaw ? SnapshotEncoding::Raw : SnapshotEncoding::RunLength);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load")) simThread.Load(snapshotPath);
+        ImGui::SameLine();
+        ImGui::Checkbox("Raw", &saveRaw);
+
+        ImGui::InputText("Journal", journalPath, sizeof(journalPath));
+        if (frame.recording) {
+            if (ImGui::Button("Stop Recording")) simThread.StopRecording();
+        } else if (ImGui::Button("Record")) {
+            simThread.StartRecording(journalPath);
+        }
+
+        ImGui::Separator();
+        ImGui::Text("Timeline");
+        ImGui::SliderInt("Auto Checkpoint (ticks)", &settings.checkpointIntervalTicks, 0, 2000);
+        if (ImGui::Button("Checkpoint")) simThread.Checkpoint();
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Checkpoints")) simThread.ClearCheckpoints();
+        ImGui::Text("Checkpoints: %zu in %.2f MiB", frame.checkpointTicks.size(), frame.checkpointBytes / 1048576.0);
+        if (!frame.checkpointTicks.empty()) {
+            int last = static_cast<int>(frame.checkpointTicks.size()) - 1;
+            checkpointIdx = std::clamp(checkpointIdx, 0, last);
+            char format[64];
+            std::snprintf(format, sizeof(format), "%%d: tick %llu", static_cast<unsigned long long>(frame.checkpointTicks[checkpointIdx]));
+            ImGui::SliderInt("##checkpoint", &checkpointIdx, 0, last, format);
+            ImGui::SameLine();
+            if (ImGui::Button("Rewind")) simThread.Rewind(static_cast<size_t>(checkpointIdx));
+        }
         ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
         ImGui::End();
 
+        simThread.SetSettings(settings);
+
         // --- Simulation View ---
         ImGui::SetNextWindowSize(ImVec2(600, 600), ImGuiCond_FirstUseEver);
         ImGui::Begin("Simulation View");
@@ -595,70 +260,88 @@ int main() {
         ImVec2 p = ImGui::GetCursorScreenPos();
         ImVec2 avail = ImGui::GetContentRegionAvail();
 
-        float cellW = avail.x / static_cast<float>(sim.width);
-        float cellH = avail.y / static_cast<float>(sim.height);
+        float cellW = avail.x / static_cast<float>(frame.width);
+        float cellH = avail.y / static_cast<float>(frame.height);
         float cellSize = std::min(cellW, cellH);
 
         // Background
-        draw_list->AddRectFilled(p, ImVec2(p.x + sim.width * cellSize, p.y + sim.height * cellSize), IM_COL32(255, 255, 255, 255));
+        draw_list->AddRectFilled(p, ImVec2(p.x + frame.width * cellSize, p.y + frame.height * cellSize), IM_COL32(255, 255, 255, 255));
 
         // Grid Lines
         ImU32 gridCol = IM_COL32(220, 220, 220, 255);
-        for (int i = 0; i <= sim.width; ++i)
-            draw_list->AddLine(ImVec2(p.x + i * cellSize, p.y), ImVec2(p.x + i * cellSize, p.y + sim.height * cellSize), gridCol);
-        for (int i = 0; i <= sim.height; ++i)
-            draw_list->AddLine(ImVec2(p.x, p.y + i * cellSize), ImVec2(p.x + sim.width * cellSize, p.y + i * cellSize), gridCol);
-
-        // Particles
-        for (int y = 0; y < sim.height; ++y) {
-            for (int x = 0; x < sim.width; ++x) {
-                Cell c = sim.Get(x, y);
-                if (c.type != MaterialType::Empty) {
+        for (int i = 0; i <= frame.width; ++i)
+            draw_list->AddLine(ImVec2(p.x + i * cellSize, p.y), ImVec2(p.x + i * cellSize, p.y + frame.height * cellSize), gridCol);
+        for (int i = 0; i <= frame.height; ++i)
+            draw_list->AddLine(ImVec2(p.x, p.y + i * cellSize), ImVec2(p.x + frame.width * cellSize, p.y + i * cellSize), gridCol);
+
+        // Particles, a set bit of the row occupancy at a time
+        for (int y = 0; y < frame.height; ++y) {
+            const uint64_t* row = frame.GetOccupancyRow(y);
+            for (int w = 0; w < frame.occupancyWords; ++w) {
+                for (uint64_t bits = row[w]; bits != 0; bits &= bits - 1) {
+                    int x = w * bitboard::WORD_BITS + __builtin_ctzll(bits);
                     ImVec2 min = ImVec2(p.x + x * cellSize, p.y + y * cellSize);
                     ImVec2 max = ImVec2(min.x + cellSize, min.y + cellSize);
-                    draw_list->AddRectFilled(min, max, GetColor(c));
+                    draw_list->AddRectFilled(min, max, GetColor(frame.Get(x, y)));
                 }
             }
         }
 
+        // Dirty rects of awake chunks
+        if (showChunks) {
+            // Coarse chunks are shaded; awake rects are outlined
+            for (size_t i = 0; i < frame.coarseChunks.size(); ++i) {
+                if (!frame.coarseChunks[i]) continue;
+                int cx = static_cast<int>(i) % frame.chunksX;
+                int cy = static_cast<int>(i) / frame.chunksX;
+                ImVec2 min = ImVec2(p.x + cx * CHUNK_SIZE * cellSize, p.y + cy * CHUNK_SIZE * cellSize);
+                ImVec2 max = ImVec2(p.x + std::min((cx + 1) * CHUNK_SIZE, frame.width) * cellSize,
+                                    p.y + std::min((cy + 1) * CHUNK_SIZE, frame.height) * cellSize);
+                draw_list->AddRectFilled(min, max, IM_COL32(0, 255, 255, 24));
+            }
+            for (const DirtyRect& rect : frame.chunkRects) {
+                if (rect.IsEmpty()) continue;
+                ImVec2 min = ImVec2(p.x + rect.minX * cellSize, p.y + rect.minY * cellSize);
+                ImVec2 max = ImVec2(p.x + (rect.maxX + 1) * cellSize, p.y + (rect.maxY + 1) * cellSize);
+                draw_list->AddRect(min, max, IM_COL32(255, 0, 255, 255));
+            }
+            if (!frame.region.IsEmpty()) {
+                ImVec2 min = ImVec2(p.x + frame.region.minX * cellSize, p.y + frame.region.minY * cellSize);
+                ImVec2 max = ImVec2(p.x + (frame.region.maxX + 1) * cellSize, p.y + (frame.region.maxY + 1) * cellSize);
+                draw_list->AddRect(min, max, IM_COL32(255, 160, 0, 255));
+            }
+        }
+
         // Interactions
+        SimInput input;
+        input.driveWithMouse = simulateInput;
+        bool painting = false;
         if (ImGui::IsWindowHovered()) {
             ImVec2 m = ImGui::GetMousePos();
             glm::vec2 mouseGridPos;
             mouseGridPos.x = (m.x - p.x) / cellSize;
             mouseGridPos.y = (m.y - p.y) / cellSize;
+            input.hovered = true;
+            input.mouseGridPos = mouseGridPos;
 
             if (ImGui::IsKeyPressed(ImGuiKey_G)) {
-                haptics.Recenter(mouseGridPos);
+                simThread.Recenter(mouseGridPos);
             }
 
             if (ImGui::IsMouseDown(ImGuiMouseButton_Left) || ImGui::IsMouseDown(ImGuiMouseButton_Right)) {
                 auto type = static_cast<MaterialType>(currentMaterialIdx);
                 int initialSoak = (type == MaterialType::WetSand) ? SOAK_THRESHOLD : 0;
-                sim.Set(static_cast<int>(mouseGridPos.x), static_cast<int>(mouseGridPos.y), type, initialSoak);
+                // Each frame's stroke starts where the last one ended, so fast drags leave no gaps
+                glm::vec2 cell = glm::floor(mouseGridPos);
+                simThread.PaintStroke(wasPainting ? lastPaintPos : cell, cell, brushRadius, type, initialSoak);
+                lastPaintPos = cell;
+                painting = true;
             }
-
-            if (device.connected) {
-                device.Sync(haptics.currentForce1D);
-            }
-
-            if (simulateInput) {
-                haptics.Update(mouseGridPos, 0.0f, true, sim);
-            } else {
-                float meters = device.GetPositionMeters();
-                haptics.Update(glm::vec2(0,0), meters, false, sim);
-            }
-        } else {
-             if (device.connected) device.Sync(haptics.currentForce1D);
-
-             if (!simulateInput && device.connected) {
-                 haptics.Update(glm::vec2(0,0), device.GetPositionMeters(), false, sim);
-             } else {
-                 haptics.Update(haptics.devicePos, 0.0f, false, sim);
-             }
         }
+        wasPainting = painting;
+        simThread.SetInput(input);
 
-        haptics.Render(draw_list, p, cellSize);
+        RenderHaptics(haptics, draw_list, p, cellSize);
 
         ImGui::End();
 
@@ -667,6 +350,8 @@ int main() {
         glfwSwapBuffers(window);
     }
 
+    simThread.Stop();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
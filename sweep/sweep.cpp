@@ -0,0 +1,212 @@
+// Batch runner for tuning the tool against recorded sessions. Replays one journal once
+// per combination of tool parameters, spreading the runs over a worker pool, and writes
+// each run's force and resistance metrics to CSV.
+//
+// Usage: sandsim_sweep --trace FILE [--friction LIST] [--spring LIST] [--radius LIST]
+//                      [--threads N] [--out FILE]
+// A LIST is comma-separated values or lo:hi:count, e.g. 0.5,1,2 or 1:10:10. Parameters
+// left out keep the values recorded in the trace.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "core/haptic_system.h"
+#include "core/input_journal.h"
+#include "core/sand_simulation.h"
+#include "core/sim_settings.h"
+#include "core/worker_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct SweepConfig {
+    std::string tracePath;
+    std::string outPath = "sweep.csv";
+    std::vector<float> friction;
+    std::vector<float> spring;
+    std::vector<float> radius;
+    int threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+};
+
+// One combination; unset parameters keep the trace's values
+struct SweepRun {
+    std::optional<float> friction;
+    std::optional<float> spring;
+    std::optional<float> radius;
+};
+
+struct SweepResult {
+    bool ok = false;
+    float friction = 0.0f;
+    float spring = 0.0f;
+    float radius = 0.0f;
+    uint64_t ticks = 0;
+    uint64_t hapticUpdates = 0;
+    double forceSum = 0.0;
+    float peakForce = 0.0f;
+    double resistanceSum = 0.0;
+    float peakResistance = 0.0f;
+    uint64_t gridHash = 0;
+    double ms = 0.0;
+};
+
+SweepResult RunTrace(const std::string& tracePath, const SweepRun& run) {
+    SandSimulation sim;
+    HapticSystem haptics;
+    SweepResult result;
+
+    JournalReplayHooks hooks;
+    hooks.adjustSettings = [&run](SimSettings& settings) {
+        if (run.friction) settings.frictionCoef = *run.friction;
+        if (run.spring) settings.springK = *run.spring;
+        if (run.radius) settings.radius = *run.radius;
+        // The result does not depend on the thread count, and runs already fill every core
+        settings.threadCount = 1;
+    };
+    hooks.onHaptics = [&result](const HapticSystem& state) {
+        float force = glm::length(state.force);
+        result.forceSum += force;
+        result.peakForce = std::max(result.peakForce, force);
+        result.resistanceSum += state.smoothedResistance;
+        result.peakResistance = std::max(result.peakResistance, state.smoothedResistance);
+    };
+
+    auto start = Clock::now();
+    JournalReplayStats stats;
+    result.ok = ReplayJournal(tracePath, sim, haptics, &stats, &hooks);
+    result.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    result.friction = haptics.frictionCoef;
+    result.spring = haptics.springK;
+    result.radius = haptics.radius;
+    result.ticks = stats.ticks;
+    result.hapticUpdates = stats.hapticUpdates;
+    result.gridHash = sim.ComputeGridHash();
+    return result;
+}
+
+// Every combination of the listed values
+std::vector<SweepRun> ExpandRuns(const SweepConfig& cfg) {
+    auto options = [](const std::vector<float>& values) {
+        std::vector<std::optional<float>> out(values.begin(), values.end());
+        if (out.empty()) out.emplace_back();
+        return out;
+    };
+    std::vector<SweepRun> runs;
+    for (const auto& friction : options(cfg.friction)) {
+        for (const auto& spring : options(cfg.spring)) {
+            for (const auto& radius : options(cfg.radius)) runs.push_back({ friction, spring, radius });
+        }
+    }
+    return runs;
+}
+
+bool WriteCsv(const std::string& path, const std::vector<SweepResult>& results) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        std::fprintf(stderr, "[Error] WriteCsv: cannot create %s\n", path.c_str());
+        return false;
+    }
+    std::fprintf(file, "run,ok,friction,spring,radius,ticks,haptic_updates,mean_force,peak_force,"
+                       "mean_resistance,peak_resistance,grid_hash,ms\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& r = results[i];
+        double updates = std::max<double>(static_cast<double>(r.hapticUpdates), 1.0);
+        std::fprintf(file, "%zu,%d,%g,%g,%g,%llu,%llu,%.6g,%.6g,%.6g,%.6g,%016llx,%.3f\n", i, r.ok ? 1 : 0,
+                     r.friction, r.spring, r.radius, static_cast<unsigned long long>(r.ticks),
+                     static_cast<unsigned long long>(r.hapticUpdates), r.forceSum / updates, r.peakForce,
+                     r.resistanceSum / updates, r.peakResistance, static_cast<unsigned long long>(r.gridHash), r.ms);
+    }
+    return std::fclose(file) == 0;
+}
+
+bool ParseValues(const std::string& text, std::vector<float>& out) {
+    float lo = 0.0f, hi = 0.0f;
+    int count = 0;
+    char extra = 0;
+    if (std::sscanf(text.c_str(), "%f:%f:%d%c", &lo, &hi, &count, &extra) == 3) {
+        if (count < 1) return false;
+        for (int i = 0; i < count; ++i) out.push_back(count == 1 ? lo : lo + (hi - lo) * i / (count - 1));
+        return true;
+    }
+
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t end = std::min(text.find(',', pos), text.size());
+        std::string item = text.substr(pos, end - pos);
+        char* stop = nullptr;
+        float value = std::strtof(item.c_str(), &stop);
+        if (item.empty() || *stop != '\0') return false;
+        out.push_back(value);
+        pos = end + 1;
+    }
+    return true;
+}
+
+bool ParseArgs(int argc, char** argv, SweepConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--trace" && hasValue) {
+            cfg.tracePath = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            cfg.outPath = argv[++i];
+        } else if (arg == "--friction" && hasValue) {
+            if (!ParseValues(argv[++i], cfg.friction)) return false;
+        } else if (arg == "--spring" && hasValue) {
+            if (!ParseValues(argv[++i], cfg.spring)) return false;
+        } else if (arg == "--radius" && hasValue) {
+            if (!ParseValues(argv[++i], cfg.radius)) return false;
+        } else if (arg == "--threads" && hasValue) {
+            cfg.threads = std::max(1, std::atoi(argv[++i]));
+        } else {
+            return false;
+        }
+    }
+    return !cfg.tracePath.empty();
+}
+
+}
+
+int main(int argc, char** argv) {
+    SweepConfig cfg;
+    if (!ParseArgs(argc, argv, cfg)) {
+        std::fprintf(stderr, "Usage: %s --trace FILE [--friction LIST] [--spring LIST] [--radius LIST] [--threads N] [--out FILE]\n"
+                     "       LIST is v1,v2,... or lo:hi:count\n", argv[0]);
+        return 1;
+    }
+
+    // One bad trace would otherwise fail every run
+    SweepResult probe = RunTrace(cfg.tracePath, SweepRun{});
+    if (!probe.ok) return 1;
+
+    std::vector<SweepRun> runs = ExpandRuns(cfg);
+    std::vector<SweepResult> results(runs.size());
+    std::printf("sweep %s runs=%zu threads=%d ticks=%llu haptics=%llu  single run %.1f ms\n", cfg.tracePath.c_str(),
+                runs.size(), cfg.threads, static_cast<unsigned long long>(probe.ticks),
+                static_cast<unsigned long long>(probe.hapticUpdates), probe.ms);
+
+    // Runs are independent and take about as long as each other; the pool hands them out
+    // one at a time, so a worker that finishes early takes the next run
+    WorkerPool pool(cfg.threads);
+    auto start = Clock::now();
+    pool.ParallelFor(static_cast<int>(runs.size()), [&](int run, int) { results[run] = RunTrace(cfg.tracePath, runs[run]); });
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    size_t failed = std::count_if(results.begin(), results.end(), [](const SweepResult& r) { return !r.ok; });
+    std::printf("  %zu runs in %.1f ms  %.2f runs/s  %.2fx one thread  failed %zu\n", runs.size(), ms,
+                runs.size() * 1000.0 / ms, runs.size() * probe.ms / ms, failed);
+    if (!WriteCsv(cfg.outPath, results)) return 1;
+    std::printf("  wrote %s\n", cfg.outPath.c_str());
+    return failed == 0 ? 0 : 1;
+}